@@ -0,0 +1,23 @@
+--
+-- text_func_adaptive with forced strategies and with automatic
+-- selection of strategy (1M calls)
+--
+CREATE EXTENSION IF NOT EXISTS simple;
+
+\timing on
+
+SET simple.adaptive_strategy TO direct;
+SELECT count(text_func_adaptive('x' || i)) FROM generate_series(1, 1000000) g(i);
+
+SET simple.adaptive_strategy TO fmgr;
+SELECT count(text_func_adaptive('x' || i)) FROM generate_series(1, 1000000) g(i);
+
+SET simple.adaptive_strategy TO spi;
+SELECT count(text_func_adaptive('x' || i)) FROM generate_series(1, 1000000) g(i);
+
+SET simple.adaptive_strategy TO auto;
+SELECT count(text_func_adaptive('x' || i)) FROM generate_series(1, 1000000) g(i);
+
+\timing off
+
+SELECT * FROM simple_adaptive_stats();
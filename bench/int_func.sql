@@ -0,0 +1,39 @@
+--
+-- Comparison of int_func implementations over 100M rows
+--
+--   simple_0 - unchecked arg + 10 (wraps at INT_MAX)
+--   simple_1 - DirectFunctionCall2(int4pl, ...)
+--   simple   - overflow checked by pg_add_s32_overflow
+--
+-- The lesson modules simple_N are installed together with extension.
+--
+CREATE EXTENSION IF NOT EXISTS simple;
+
+CREATE FUNCTION pg_temp.int_func_unchecked(int)
+	RETURNS int
+	AS '$libdir/simple_0', 'int_func'
+	LANGUAGE C
+	IMMUTABLE STRICT;
+
+CREATE FUNCTION pg_temp.int_func_dfc(int)
+	RETURNS int
+	AS '$libdir/simple_1', 'int_func'
+	LANGUAGE C
+	IMMUTABLE STRICT;
+
+SET max_parallel_workers_per_gather TO 0;
+SET jit TO off;
+
+\timing on
+
+-- the cost of generating rows
+SELECT sum(g) FROM (SELECT generate_series(1, 100000000) g) s;
+
+SELECT sum(pg_temp.int_func_unchecked(g)) FROM (SELECT generate_series(1, 100000000) g) s;
+SELECT sum(pg_temp.int_func_dfc(g)) FROM (SELECT generate_series(1, 100000000) g) s;
+SELECT sum(int_func(g)) FROM (SELECT generate_series(1, 100000000) g) s;
+
+-- builtin operator for comparison
+SELECT sum(g + 10) FROM (SELECT generate_series(1, 100000000) g) s;
+
+\timing off
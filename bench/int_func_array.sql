@@ -0,0 +1,41 @@
+--
+-- PL/pgSQL loop with 1000 iterations of arr := int_func(arr) over
+-- array with 1M fields.
+--
+-- On PostgreSQL 18 and higher the variable is passed as read/write
+-- expanded array (see int_func_array_support), and it is modified
+-- in place. Elsewhere the array is copied in every iteration. The
+-- loop with SQL expression is the baseline.
+--
+CREATE EXTENSION IF NOT EXISTS simple;
+
+CREATE FUNCTION pg_temp.bench_int_func(n int, iterations int)
+RETURNS int AS $$
+DECLARE a int[] := array_fill(0, ARRAY[n]);
+BEGIN
+  FOR i IN 1..iterations
+  LOOP
+    a := int_func(a);
+  END LOOP;
+  RETURN a[n];
+END;
+$$ LANGUAGE plpgsql;
+
+CREATE FUNCTION pg_temp.bench_sql(n int, iterations int)
+RETURNS int AS $$
+DECLARE a int[] := array_fill(0, ARRAY[n]);
+BEGIN
+  FOR i IN 1..iterations
+  LOOP
+    a := ARRAY(SELECT v + 10 FROM unnest(a) v);
+  END LOOP;
+  RETURN a[n];
+END;
+$$ LANGUAGE plpgsql;
+
+\timing on
+
+SELECT pg_temp.bench_int_func(1000000, 1000);
+SELECT pg_temp.bench_sql(1000000, 100);
+
+\timing off
@@ -0,0 +1,39 @@
+--
+-- JIT compilation of expressions with int_func and text_func
+--
+-- The inlining is possible only when bitcode of extension
+-- is installed (see EXPLAIN ANALYZE output, section JIT).
+--
+CREATE EXTENSION IF NOT EXISTS simple;
+
+SET client_min_messages TO warning;
+SET max_parallel_workers_per_gather TO 0;
+SET simple.enable_batch_scan TO off;
+
+CREATE TEMP TABLE jit_data AS SELECT i, 'row ' || i AS t FROM generate_series(1, 10000000) g(i);
+VACUUM ANALYZE jit_data;
+
+\timing on
+
+SET jit TO off;
+SELECT sum(int_func(i)) FROM jit_data;
+SELECT sum(length(text_func(t))) FROM jit_data;
+
+SET jit TO on;
+SET jit_above_cost TO 0;
+SET jit_optimize_above_cost TO 0;
+SET jit_inline_above_cost TO 0;
+SELECT sum(int_func(i)) FROM jit_data;
+SELECT sum(length(text_func(t))) FROM jit_data;
+
+\timing off
+
+EXPLAIN (ANALYZE, COSTS OFF) SELECT sum(int_func(i)) FROM jit_data;
+
+-- JIT without inlining
+SET jit_inline_above_cost TO -1;
+\timing on
+SELECT sum(int_func(i)) FROM jit_data;
+\timing off
+
+DROP TABLE jit_data;
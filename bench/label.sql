@@ -0,0 +1,42 @@
+--
+-- Dictionary encoded labels
+--
+-- Size of table and time of grouping and join of text values and
+-- dictionary encoded values (simple_label) with few distinct values.
+--
+CREATE EXTENSION IF NOT EXISTS simple;
+
+SET client_min_messages TO warning;
+
+CREATE TEMP TABLE bench_text(id int, v text);
+CREATE TEMP TABLE bench_label(id int, v simple_label);
+CREATE TEMP TABLE bench_dim_text(v text PRIMARY KEY, n int);
+CREATE TEMP TABLE bench_dim_label(v simple_label PRIMARY KEY, n int);
+
+INSERT INTO bench_text
+  SELECT i, text_func('category ' || i % 20) FROM generate_series(1, 1000000) g(i);
+INSERT INTO bench_label
+  SELECT id, v FROM bench_text;
+
+INSERT INTO bench_dim_text
+  SELECT DISTINCT v, 0 FROM bench_text;
+INSERT INTO bench_dim_label
+  SELECT DISTINCT v, 0 FROM bench_label;
+
+VACUUM ANALYZE bench_text, bench_label, bench_dim_text, bench_dim_label;
+
+SELECT pg_size_pretty(pg_table_size('bench_text')) AS text,
+       pg_size_pretty(pg_table_size('bench_label')) AS label;
+
+\timing on
+
+SELECT count(DISTINCT v) FROM bench_text;
+SELECT count(DISTINCT v) FROM bench_label;
+
+SELECT count(*) FROM (SELECT v FROM bench_text GROUP BY v) s;
+SELECT count(*) FROM (SELECT v FROM bench_label GROUP BY v) s;
+
+SELECT sum(d.n) FROM bench_text t JOIN bench_dim_text d USING (v);
+SELECT sum(d.n) FROM bench_label t JOIN bench_dim_label d USING (v);
+
+\timing off
@@ -0,0 +1,10 @@
+--
+-- Serialization and deserialization of option list (List of DefElem)
+--
+-- The text format (nodeToString, stringToNode) is compared with
+-- compact binary format. Times are in ms.
+--
+CREATE EXTENSION IF NOT EXISTS simple;
+
+SELECT * FROM simple_nodes_bench(1000);
+SELECT * FROM simple_nodes_bench(100000);
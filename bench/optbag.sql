@@ -0,0 +1,42 @@
+--
+-- Accumulation of key/value pairs in PL/pgSQL loop
+--
+-- The expanded optbag is modified in place (PostgreSQL 18 and higher),
+-- or copied without parsing. jsonb value is parsed and serialized by
+-- any iteration.
+--
+CREATE EXTENSION IF NOT EXISTS simple;
+
+CREATE FUNCTION pg_temp.bench_optbag(n int)
+RETURNS int AS $$
+DECLARE bag optbag;
+BEGIN
+  FOR i IN 1..n
+  LOOP
+    bag := optbag_set(bag, 'key ' || i, 'value ' || i);
+  END LOOP;
+  RETURN optbag_count(bag);
+END;
+$$ LANGUAGE plpgsql;
+
+CREATE FUNCTION pg_temp.bench_jsonb(n int)
+RETURNS int AS $$
+DECLARE bag jsonb DEFAULT '{}';
+BEGIN
+  FOR i IN 1..n
+  LOOP
+    bag := bag || jsonb_build_object('key ' || i, 'value ' || i);
+  END LOOP;
+  RETURN (SELECT count(*) FROM jsonb_object_keys(bag));
+END;
+$$ LANGUAGE plpgsql;
+
+\timing on
+
+SELECT pg_temp.bench_optbag(10000);
+SELECT pg_temp.bench_jsonb(10000);
+
+SELECT pg_temp.bench_optbag(50000);
+SELECT pg_temp.bench_jsonb(50000);
+
+\timing off
@@ -0,0 +1,43 @@
+--
+-- text_func by SPI (lesson simple_7) called for any value versus
+-- text_func_batch, that executes all queries inside one SPI
+-- connection with saved plan (spi_pipeline.c)
+--
+-- The query of text_func has no tables, and it is evaluated without
+-- portal and snapshot (simple.pipeline_fast_path). The difference of
+-- times with and without fast path divided by 1M is the saving per call.
+--
+CREATE EXTENSION IF NOT EXISTS simple;
+
+CREATE FUNCTION pg_temp.text_func_spi(text)
+	RETURNS text
+	AS '$libdir/simple_7', 'text_func'
+	LANGUAGE C
+	IMMUTABLE;
+
+SET client_min_messages TO warning;
+SET max_parallel_workers_per_gather TO 0;
+
+CREATE TEMP TABLE spi_data AS SELECT i / 100 AS grp, 'row ' || i AS t FROM generate_series(1, 1000000) g(i);
+VACUUM ANALYZE spi_data;
+
+\timing on
+
+-- one SPI_connect, parsing and planning per value
+SELECT count(pg_temp.text_func_spi(t)) FROM spi_data;
+
+-- one SPI_connect per 100 values, plans are reused
+SET simple.pipeline_fast_path TO off;
+SELECT sum(cardinality(text_func_batch(a)))
+  FROM (SELECT array_agg(t) AS a FROM spi_data GROUP BY grp) s;
+
+-- expressions are evaluated directly
+SET simple.pipeline_fast_path TO on;
+SELECT sum(cardinality(text_func_batch(a)))
+  FROM (SELECT array_agg(t) AS a FROM spi_data GROUP BY grp) s;
+
+-- cost of aggregation without queries
+SELECT sum(cardinality(a))
+  FROM (SELECT array_agg(t) AS a FROM spi_data GROUP BY grp) s;
+
+\timing off
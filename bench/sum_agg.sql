@@ -0,0 +1,28 @@
+--
+-- Sliding window sum over 10M rows
+--
+-- simple_sum has inverse transition function, so the cost per row doesn't
+-- depend on size of frame. Builtin sum(int) has moving mode too, builtin
+-- sum(bigint) accumulates in numeric.
+--
+CREATE EXTENSION IF NOT EXISTS simple;
+
+\timing on
+
+SELECT max(s) FROM (
+  SELECT simple_sum(int_func(i)) OVER (ORDER BY i ROWS BETWEEN 1000 PRECEDING AND CURRENT ROW) s
+    FROM generate_series(1, 10000000) g(i)) x;
+
+SELECT max(s) FROM (
+  SELECT sum(int_func(i)) OVER (ORDER BY i ROWS BETWEEN 1000 PRECEDING AND CURRENT ROW) s
+    FROM generate_series(1, 10000000) g(i)) x;
+
+SELECT max(s) FROM (
+  SELECT simple_sum(int_func(i::bigint)) OVER (ORDER BY i ROWS BETWEEN 1000 PRECEDING AND CURRENT ROW) s
+    FROM generate_series(1, 10000000) g(i)) x;
+
+SELECT max(s) FROM (
+  SELECT sum(int_func(i::bigint)) OVER (ORDER BY i ROWS BETWEEN 1000 PRECEDING AND CURRENT ROW) s
+    FROM generate_series(1, 10000000) g(i)) x;
+
+\timing off
@@ -0,0 +1,21 @@
+--
+-- format() versus text_format_fast() with constant template
+--
+CREATE EXTENSION IF NOT EXISTS simple;
+
+SET max_parallel_workers_per_gather TO 0;
+SET jit TO off;
+
+CREATE TEMP TABLE format_data AS SELECT i, 'row ' || i AS label FROM generate_series(1, 10000000) g(i);
+VACUUM ANALYZE format_data;
+
+\timing on
+
+SELECT sum(length(format('id: %s, label: %s, value: %s', i, label, label))) FROM format_data;
+SELECT sum(length(text_format_fast('id: %s, label: %s, value: %s', i, label, label))) FROM format_data;
+
+-- only text arguments
+SELECT sum(length(format('[%s] %s', label, label))) FROM format_data;
+SELECT sum(length(text_format_fast('[%s] %s', label, label))) FROM format_data;
+
+\timing off
@@ -0,0 +1,21 @@
+--
+-- Scaling of text_func_parallel over 10M fields with 1, 2, 4, 8
+-- and 16 background workers (max_worker_processes should be 17
+-- or higher). text_func_batch is the single process baseline.
+--
+CREATE EXTENSION IF NOT EXISTS simple;
+
+CREATE TEMP TABLE bench_input AS
+  SELECT array_agg('row ' || i) AS a FROM generate_series(1, 10000000) g(i);
+
+\timing on
+
+SELECT cardinality(text_func_batch(a)) FROM bench_input;
+
+SELECT cardinality(text_func_parallel(a, 1)) FROM bench_input;
+SELECT cardinality(text_func_parallel(a, 2)) FROM bench_input;
+SELECT cardinality(text_func_parallel(a, 4)) FROM bench_input;
+SELECT cardinality(text_func_parallel(a, 8)) FROM bench_input;
+SELECT cardinality(text_func_parallel(a, 16)) FROM bench_input;
+
+\timing off
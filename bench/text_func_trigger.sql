@@ -0,0 +1,55 @@
+--
+-- Maintenance of precomputed text_func column
+--
+-- Bulk UPDATE of 1M rows, where only 5 % of source values are changed.
+-- The row trigger evaluates text_func for every updated row, the
+-- statement trigger (text_func_maintain) updates only rows with
+-- changed source by one UPDATE.
+--
+CREATE EXTENSION IF NOT EXISTS simple;
+
+SET client_min_messages TO warning;
+
+CREATE FUNCTION pg_temp.bench_row_trigger()
+RETURNS trigger AS $$
+BEGIN
+  NEW.name_text := text_func(NEW.name);
+  RETURN NEW;
+END;
+$$ LANGUAGE plpgsql;
+
+CREATE TEMP TABLE bench_row(id int PRIMARY KEY, name text, name_text text, counter int);
+CREATE TEMP TABLE bench_stmt(id int PRIMARY KEY, name text, name_text text, counter int);
+
+CREATE TRIGGER bench_row_trg BEFORE INSERT OR UPDATE ON bench_row
+  FOR EACH ROW
+  EXECUTE FUNCTION pg_temp.bench_row_trigger();
+
+CREATE TRIGGER bench_stmt_ins AFTER INSERT ON bench_stmt
+  REFERENCING NEW TABLE AS new_rows
+  FOR EACH STATEMENT
+  EXECUTE FUNCTION text_func_maintain('id', 'name', 'name_text');
+
+CREATE TRIGGER bench_stmt_upd AFTER UPDATE ON bench_stmt
+  REFERENCING OLD TABLE AS old_rows NEW TABLE AS new_rows
+  FOR EACH STATEMENT
+  EXECUTE FUNCTION text_func_maintain('id', 'name', 'name_text');
+
+INSERT INTO bench_row SELECT i, 'name ' || i, NULL, 0 FROM generate_series(1, 1000000) g(i);
+INSERT INTO bench_stmt SELECT i, 'name ' || i, NULL, 0 FROM generate_series(1, 1000000) g(i);
+
+VACUUM ANALYZE bench_row, bench_stmt;
+
+\timing on
+
+UPDATE bench_row
+   SET counter = counter + 1,
+       name = CASE WHEN id % 20 = 0 THEN name || ' changed' ELSE name END;
+
+UPDATE bench_stmt
+   SET counter = counter + 1,
+       name = CASE WHEN id % 20 = 0 THEN name || ' changed' ELSE name END;
+
+\timing off
+
+SELECT count(*) FROM bench_stmt WHERE name_text IS DISTINCT FROM text_func(name);
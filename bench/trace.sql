@@ -0,0 +1,26 @@
+--
+-- Overhead of tracing of int_func calls over 10M rows
+--
+-- Without hook, with hook (tracing to ring buffer) and events per second
+-- in trace buffer. Tracing requires superuser.
+--
+CREATE EXTENSION IF NOT EXISTS simple;
+
+LOAD 'simple';
+
+\timing on
+
+SELECT sum(int_func(i)) FROM generate_series(1, 10000000) g(i);
+
+SET simple.trace_calls TO on;
+
+SELECT sum(int_func(i)) FROM generate_series(1, 10000000) g(i);
+
+RESET simple.trace_calls;
+
+\timing off
+
+SELECT count(*) AS events,
+       round(count(*) / extract(epoch FROM max(ts) - min(ts))) AS events_per_sec
+  FROM simple_trace_read()
+ WHERE pid = pg_backend_pid();
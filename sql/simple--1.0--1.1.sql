@@ -0,0 +1,556 @@
+-- complain if script is sourced in psql, rather than via ALTER EXTENSION
+\echo Use "ALTER EXTENSION simple UPDATE TO '1.1'" to load this file. \quit
+
+---------------------------------------------------
+CREATE FUNCTION int_func(smallint)
+	RETURNS smallint
+	AS 'MODULE_PATHNAME', 'int_func_int2'
+	LANGUAGE C
+	IMMUTABLE STRICT;
+
+CREATE FUNCTION int_func(bigint)
+	RETURNS bigint
+	AS 'MODULE_PATHNAME', 'int_func_int8'
+	LANGUAGE C
+	IMMUTABLE STRICT;
+
+CREATE FUNCTION int_func_array_support(internal)
+	RETURNS internal
+	AS 'MODULE_PATHNAME'
+	LANGUAGE C
+	IMMUTABLE STRICT;
+
+CREATE FUNCTION int_func(int[])
+	RETURNS int[]
+	AS 'MODULE_PATHNAME', 'int_func_array'
+	LANGUAGE C
+	IMMUTABLE STRICT
+	SUPPORT int_func_array_support;
+
+---------------------------------------------------
+-- instrumentation of int_func and text_func
+---------------------------------------------------
+CREATE FUNCTION simple_memory_stats(OUT funcid regprocedure,
+									OUT calls bigint,
+									OUT total_bytes bigint,
+									OUT peak_bytes bigint,
+									OUT live_contexts bigint,
+									OUT live_bytes bigint,
+									OUT max_live_bytes bigint)
+	RETURNS SETOF record
+	AS 'MODULE_PATHNAME'
+	LANGUAGE C
+	VOLATILE;
+
+CREATE FUNCTION simple_memory_stats_reset()
+	RETURNS void
+	AS 'MODULE_PATHNAME'
+	LANGUAGE C
+	VOLATILE;
+
+CREATE FUNCTION simple_trace_read(since bigint DEFAULT 0,
+								  OUT pos bigint,
+								  OUT pid int,
+								  OUT funcid regprocedure,
+								  OUT event text,
+								  OUT ts timestamptz)
+	RETURNS SETOF record
+	AS 'MODULE_PATHNAME'
+	LANGUAGE C
+	VOLATILE STRICT;
+
+CREATE FUNCTION simple_query_stats(OUT queryid bigint,
+								   OUT dbid oid,
+								   OUT funcid regprocedure,
+								   OUT calls bigint,
+								   OUT total_time float8)
+	RETURNS SETOF record
+	AS 'MODULE_PATHNAME'
+	LANGUAGE C
+	VOLATILE;
+
+CREATE FUNCTION simple_query_stats_reset()
+	RETURNS void
+	AS 'MODULE_PATHNAME'
+	LANGUAGE C
+	VOLATILE;
+
+REVOKE ALL ON FUNCTION simple_query_stats_reset() FROM PUBLIC;
+
+-- same content like the file written by metrics exporter
+CREATE FUNCTION simple_metrics()
+	RETURNS text
+	AS 'MODULE_PATHNAME'
+	LANGUAGE C
+	VOLATILE;
+
+-- SPI statistics are collected only when simple is in shared_preload_libraries
+-- (PostgreSQL 18 and higher)
+CREATE FUNCTION simple_spi_stats(funcid oid,
+								 OUT executions bigint,
+								 OUT rows bigint,
+								 OUT total_time float8)
+	RETURNS record
+	AS 'MODULE_PATHNAME'
+	LANGUAGE C
+	VOLATILE STRICT;
+
+CREATE FUNCTION simple_spi_stats_reset()
+	RETURNS void
+	AS 'MODULE_PATHNAME'
+	LANGUAGE C
+	VOLATILE;
+
+REVOKE ALL ON FUNCTION simple_spi_stats_reset() FROM PUBLIC;
+
+CREATE VIEW simple_spi_stats AS
+	SELECT p.oid::regprocedure AS funcid, s.executions, s.rows, s.total_time
+	  FROM pg_proc p, simple_spi_stats(p.oid) s
+	 WHERE p.probin = 'MODULE_PATHNAME'
+	   AND s.executions IS NOT NULL;
+
+---------------------------------------------------
+-- bulk export and import in binary COPY format
+---------------------------------------------------
+CREATE FUNCTION simple_copy_out(query text, path text)
+	RETURNS bigint
+	AS 'MODULE_PATHNAME'
+	LANGUAGE C
+	VOLATILE STRICT;
+
+CREATE FUNCTION simple_copy_in(rel regclass, path text)
+	RETURNS bigint
+	AS 'MODULE_PATHNAME'
+	LANGUAGE C
+	VOLATILE STRICT;
+
+---------------------------------------------------
+-- text_func for all fields of array (SPI pipeline)
+---------------------------------------------------
+CREATE FUNCTION text_func_batch(text[])
+	RETURNS text[]
+	AS 'MODULE_PATHNAME'
+	LANGUAGE C
+	STABLE STRICT;
+
+---------------------------------------------------
+-- text_func for all fields of array (background workers)
+---------------------------------------------------
+CREATE FUNCTION text_func_parallel(text[], workers int)
+	RETURNS text[]
+	AS 'MODULE_PATHNAME'
+	LANGUAGE C
+	VOLATILE STRICT;
+
+---------------------------------------------------
+-- format() with precompiled template
+---------------------------------------------------
+CREATE FUNCTION text_format_fast(template text, VARIADIC "any")
+	RETURNS text
+	AS 'MODULE_PATHNAME'
+	LANGUAGE C
+	STABLE;
+
+CREATE FUNCTION text_format_fast(template text)
+	RETURNS text
+	AS 'MODULE_PATHNAME'
+	LANGUAGE C
+	STABLE;
+
+---------------------------------------------------
+-- key/value option bag with expanded form
+---------------------------------------------------
+CREATE TYPE optbag;
+
+CREATE FUNCTION optbag_in(cstring)
+	RETURNS optbag
+	AS 'MODULE_PATHNAME'
+	LANGUAGE C
+	IMMUTABLE STRICT;
+
+CREATE FUNCTION optbag_out(optbag)
+	RETURNS cstring
+	AS 'MODULE_PATHNAME'
+	LANGUAGE C
+	IMMUTABLE STRICT;
+
+CREATE TYPE optbag (
+	INPUT = optbag_in,
+	OUTPUT = optbag_out,
+	INTERNALLENGTH = VARIABLE,
+	STORAGE = extended
+);
+
+CREATE FUNCTION optbag_support(internal)
+	RETURNS internal
+	AS 'MODULE_PATHNAME'
+	LANGUAGE C
+	IMMUTABLE STRICT;
+
+CREATE FUNCTION optbag_set(bag optbag, key text, value text)
+	RETURNS optbag
+	AS 'MODULE_PATHNAME'
+	LANGUAGE C
+	IMMUTABLE
+	SUPPORT optbag_support;
+
+CREATE FUNCTION optbag_get(bag optbag, key text)
+	RETURNS text
+	AS 'MODULE_PATHNAME'
+	LANGUAGE C
+	IMMUTABLE STRICT;
+
+CREATE FUNCTION optbag_count(bag optbag)
+	RETURNS int
+	AS 'MODULE_PATHNAME'
+	LANGUAGE C
+	IMMUTABLE STRICT;
+
+---------------------------------------------------
+-- binary format of option lists (nodes)
+---------------------------------------------------
+CREATE FUNCTION simple_nodes_encode(text)
+	RETURNS bytea
+	AS 'MODULE_PATHNAME'
+	LANGUAGE C
+	IMMUTABLE STRICT;
+
+-- stringToNode is not safe for untrusted input
+REVOKE ALL ON FUNCTION simple_nodes_encode(text) FROM PUBLIC;
+
+CREATE FUNCTION simple_nodes_decode(bytea)
+	RETURNS text
+	AS 'MODULE_PATHNAME'
+	LANGUAGE C
+	IMMUTABLE STRICT;
+
+CREATE FUNCTION simple_nodes_bench(n int,
+								   OUT format text,
+								   OUT size bigint,
+								   OUT encode_time float8,
+								   OUT decode_time float8)
+	RETURNS SETOF record
+	AS 'MODULE_PATHNAME'
+	LANGUAGE C
+	VOLATILE STRICT;
+
+---------------------------------------------------
+-- dictionary encoded labels
+---------------------------------------------------
+CREATE SEQUENCE simple_label_dict_code_seq AS int;
+
+CREATE TABLE simple_label_dict(
+	code int PRIMARY KEY DEFAULT nextval('simple_label_dict_code_seq'),
+	label text NOT NULL UNIQUE
+);
+
+ALTER SEQUENCE simple_label_dict_code_seq OWNED BY simple_label_dict.code;
+
+-- the dictionary is dumped by pg_dump (and it is kept by pg_upgrade)
+SELECT pg_catalog.pg_extension_config_dump('simple_label_dict', '');
+SELECT pg_catalog.pg_extension_config_dump('simple_label_dict_code_seq', '');
+
+-- new labels are inserted by input function under owner of dictionary
+REVOKE ALL ON simple_label_dict FROM PUBLIC;
+GRANT SELECT ON simple_label_dict TO PUBLIC;
+
+CREATE FUNCTION simple_label_dict_invalidate()
+	RETURNS trigger
+	AS 'MODULE_PATHNAME'
+	LANGUAGE C;
+
+CREATE TRIGGER simple_label_dict_invalidate
+	AFTER UPDATE OR DELETE OR TRUNCATE ON simple_label_dict
+	FOR EACH STATEMENT
+	EXECUTE FUNCTION simple_label_dict_invalidate();
+
+-- the labels can be inserted by input function before the dictionary
+-- is restored, so restored rows should not be in conflict
+CREATE FUNCTION simple_label_dict_insert()
+	RETURNS trigger
+	AS 'MODULE_PATHNAME'
+	LANGUAGE C;
+
+CREATE TRIGGER simple_label_dict_insert
+	BEFORE INSERT ON simple_label_dict
+	FOR EACH ROW
+	EXECUTE FUNCTION simple_label_dict_insert();
+
+CREATE TYPE simple_label;
+
+-- new labels are inserted by own SPI connection, but the input
+-- functions of types should not be volatile
+CREATE FUNCTION simple_label_in(cstring)
+	RETURNS simple_label
+	AS 'MODULE_PATHNAME'
+	LANGUAGE C
+	STABLE STRICT;
+
+CREATE FUNCTION simple_label_out(simple_label)
+	RETURNS cstring
+	AS 'MODULE_PATHNAME'
+	LANGUAGE C
+	STABLE STRICT PARALLEL SAFE;
+
+CREATE FUNCTION simple_label_recv(internal)
+	RETURNS simple_label
+	AS 'MODULE_PATHNAME'
+	LANGUAGE C
+	STABLE STRICT;
+
+CREATE FUNCTION simple_label_send(simple_label)
+	RETURNS bytea
+	AS 'MODULE_PATHNAME'
+	LANGUAGE C
+	STABLE STRICT PARALLEL SAFE;
+
+CREATE TYPE simple_label (
+	INPUT = simple_label_in,
+	OUTPUT = simple_label_out,
+	RECEIVE = simple_label_recv,
+	SEND = simple_label_send,
+	INTERNALLENGTH = 4,
+	PASSEDBYVALUE,
+	ALIGNMENT = int4
+);
+
+CREATE CAST (text AS simple_label) WITH INOUT AS ASSIGNMENT;
+CREATE CAST (simple_label AS text) WITH INOUT AS ASSIGNMENT;
+
+CREATE FUNCTION simple_label_eq(simple_label, simple_label)
+	RETURNS bool
+	AS 'MODULE_PATHNAME'
+	LANGUAGE C
+	IMMUTABLE STRICT PARALLEL SAFE;
+
+CREATE FUNCTION simple_label_ne(simple_label, simple_label)
+	RETURNS bool
+	AS 'MODULE_PATHNAME'
+	LANGUAGE C
+	IMMUTABLE STRICT PARALLEL SAFE;
+
+CREATE FUNCTION simple_label_lt(simple_label, simple_label)
+	RETURNS bool
+	AS 'MODULE_PATHNAME'
+	LANGUAGE C
+	IMMUTABLE STRICT PARALLEL SAFE;
+
+CREATE FUNCTION simple_label_le(simple_label, simple_label)
+	RETURNS bool
+	AS 'MODULE_PATHNAME'
+	LANGUAGE C
+	IMMUTABLE STRICT PARALLEL SAFE;
+
+CREATE FUNCTION simple_label_gt(simple_label, simple_label)
+	RETURNS bool
+	AS 'MODULE_PATHNAME'
+	LANGUAGE C
+	IMMUTABLE STRICT PARALLEL SAFE;
+
+CREATE FUNCTION simple_label_ge(simple_label, simple_label)
+	RETURNS bool
+	AS 'MODULE_PATHNAME'
+	LANGUAGE C
+	IMMUTABLE STRICT PARALLEL SAFE;
+
+CREATE FUNCTION simple_label_cmp(simple_label, simple_label)
+	RETURNS int
+	AS 'MODULE_PATHNAME'
+	LANGUAGE C
+	IMMUTABLE STRICT PARALLEL SAFE;
+
+CREATE FUNCTION simple_label_sortsupport(internal)
+	RETURNS void
+	AS 'MODULE_PATHNAME'
+	LANGUAGE C
+	IMMUTABLE STRICT PARALLEL SAFE;
+
+CREATE FUNCTION simple_label_hash(simple_label)
+	RETURNS int
+	AS 'MODULE_PATHNAME'
+	LANGUAGE C
+	IMMUTABLE STRICT PARALLEL SAFE;
+
+CREATE FUNCTION simple_label_hash_extended(simple_label, bigint)
+	RETURNS bigint
+	AS 'MODULE_PATHNAME'
+	LANGUAGE C
+	IMMUTABLE STRICT PARALLEL SAFE;
+
+CREATE OPERATOR = (
+	LEFTARG = simple_label,
+	RIGHTARG = simple_label,
+	FUNCTION = simple_label_eq,
+	COMMUTATOR = =,
+	NEGATOR = <>,
+	RESTRICT = eqsel,
+	JOIN = eqjoinsel,
+	HASHES,
+	MERGES
+);
+
+CREATE OPERATOR <> (
+	LEFTARG = simple_label,
+	RIGHTARG = simple_label,
+	FUNCTION = simple_label_ne,
+	COMMUTATOR = <>,
+	NEGATOR = =,
+	RESTRICT = neqsel,
+	JOIN = neqjoinsel
+);
+
+CREATE OPERATOR < (
+	LEFTARG = simple_label,
+	RIGHTARG = simple_label,
+	FUNCTION = simple_label_lt,
+	COMMUTATOR = >,
+	NEGATOR = >=,
+	RESTRICT = scalarltsel,
+	JOIN = scalarltjoinsel
+);
+
+CREATE OPERATOR <= (
+	LEFTARG = simple_label,
+	RIGHTARG = simple_label,
+	FUNCTION = simple_label_le,
+	COMMUTATOR = >=,
+	NEGATOR = >,
+	RESTRICT = scalarlesel,
+	JOIN = scalarlejoinsel
+);
+
+CREATE OPERATOR > (
+	LEFTARG = simple_label,
+	RIGHTARG = simple_label,
+	FUNCTION = simple_label_gt,
+	COMMUTATOR = <,
+	NEGATOR = <=,
+	RESTRICT = scalargtsel,
+	JOIN = scalargtjoinsel
+);
+
+CREATE OPERATOR >= (
+	LEFTARG = simple_label,
+	RIGHTARG = simple_label,
+	FUNCTION = simple_label_ge,
+	COMMUTATOR = <=,
+	NEGATOR = <,
+	RESTRICT = scalargesel,
+	JOIN = scalargejoinsel
+);
+
+CREATE OPERATOR CLASS simple_label_ops
+	DEFAULT FOR TYPE simple_label USING btree AS
+		OPERATOR 1 <,
+		OPERATOR 2 <=,
+		OPERATOR 3 =,
+		OPERATOR 4 >=,
+		OPERATOR 5 >,
+		FUNCTION 1 simple_label_cmp(simple_label, simple_label),
+		FUNCTION 2 simple_label_sortsupport(internal);
+
+CREATE OPERATOR CLASS simple_label_ops
+	DEFAULT FOR TYPE simple_label USING hash AS
+		OPERATOR 1 =,
+		FUNCTION 1 simple_label_hash(simple_label),
+		FUNCTION 2 simple_label_hash_extended(simple_label, bigint);
+
+---------------------------------------------------
+-- sum with moving aggregate mode
+---------------------------------------------------
+CREATE FUNCTION simple_sum_accum(int8[], int)
+	RETURNS int8[]
+	AS 'MODULE_PATHNAME', 'simple_sum_accum_int4'
+	LANGUAGE C
+	IMMUTABLE STRICT PARALLEL SAFE;
+
+CREATE FUNCTION simple_sum_accum_inv(int8[], int)
+	RETURNS int8[]
+	AS 'MODULE_PATHNAME', 'simple_sum_accum_int4_inv'
+	LANGUAGE C
+	IMMUTABLE STRICT PARALLEL SAFE;
+
+CREATE FUNCTION simple_sum_accum(int8[], bigint)
+	RETURNS int8[]
+	AS 'MODULE_PATHNAME', 'simple_sum_accum_int8'
+	LANGUAGE C
+	IMMUTABLE STRICT PARALLEL SAFE;
+
+CREATE FUNCTION simple_sum_accum_inv(int8[], bigint)
+	RETURNS int8[]
+	AS 'MODULE_PATHNAME', 'simple_sum_accum_int8_inv'
+	LANGUAGE C
+	IMMUTABLE STRICT PARALLEL SAFE;
+
+CREATE FUNCTION simple_sum_combine(int8[], int8[])
+	RETURNS int8[]
+	AS 'MODULE_PATHNAME'
+	LANGUAGE C
+	IMMUTABLE STRICT PARALLEL SAFE;
+
+CREATE FUNCTION simple_sum_final(int8[])
+	RETURNS bigint
+	AS 'MODULE_PATHNAME'
+	LANGUAGE C
+	IMMUTABLE STRICT PARALLEL SAFE;
+
+CREATE AGGREGATE simple_sum(int) (
+	SFUNC = simple_sum_accum,
+	STYPE = int8[],
+	FINALFUNC = simple_sum_final,
+	COMBINEFUNC = simple_sum_combine,
+	INITCOND = '{0,0}',
+	MSFUNC = simple_sum_accum,
+	MINVFUNC = simple_sum_accum_inv,
+	MSTYPE = int8[],
+	MFINALFUNC = simple_sum_final,
+	MINITCOND = '{0,0}',
+	PARALLEL = SAFE
+);
+
+CREATE AGGREGATE simple_sum(bigint) (
+	SFUNC = simple_sum_accum,
+	STYPE = int8[],
+	FINALFUNC = simple_sum_final,
+	COMBINEFUNC = simple_sum_combine,
+	INITCOND = '{0,0}',
+	MSFUNC = simple_sum_accum,
+	MINVFUNC = simple_sum_accum_inv,
+	MSTYPE = int8[],
+	MFINALFUNC = simple_sum_final,
+	MINITCOND = '{0,0}',
+	PARALLEL = SAFE
+);
+
+---------------------------------------------------
+-- text_func with adaptive selection of implementation
+---------------------------------------------------
+CREATE FUNCTION text_func_adaptive(text)
+	RETURNS text
+	AS 'MODULE_PATHNAME'
+	LANGUAGE C
+	IMMUTABLE STRICT;
+
+CREATE FUNCTION simple_adaptive_stats(OUT strategy text,
+									  OUT samples bigint,
+									  OUT avg_time float8,
+									  OUT chosen bigint,
+									  OUT calls bigint)
+	RETURNS SETOF record
+	AS 'MODULE_PATHNAME'
+	LANGUAGE C
+	VOLATILE;
+
+CREATE FUNCTION simple_adaptive_stats_reset()
+	RETURNS void
+	AS 'MODULE_PATHNAME'
+	LANGUAGE C
+	VOLATILE;
+
+---------------------------------------------------
+-- maintenance of text_func column by statement trigger
+---------------------------------------------------
+CREATE FUNCTION text_func_maintain()
+	RETURNS trigger
+	AS 'MODULE_PATHNAME'
+	LANGUAGE C;
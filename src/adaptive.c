@@ -0,0 +1,373 @@
+/*-------------------------------------------------------------------------
+ *
+ * simple
+ *	  simple demo extension - adaptive selection of implementation
+ *
+ * Author:	Pavel Stehule
+ * Postcardware licence @2024
+ *
+ * IDENTIFICATION
+ *	  adaptive.c
+ *
+ * The lessons show more ways how to compute the result of text_func:
+ * direct C code (simple.c, simple_0.c), call of builtin function by
+ * DirectFunctionCall2 (simple_1.c) and SQL query executed by SPI
+ * (simple_3.c .. simple_7.c). text_func_adaptive has all three
+ * implementations (strategies):
+ *
+ *   direct  - text_func_concat (kernel of text_func)
+ *   fmgr    - DirectFunctionCall2(textcat, ...)
+ *   spi     - saved SPI plan of query SELECT $1 || $2
+ *
+ * First simple.adaptive_samples calls of the function in the query
+ * (state is stored in fn_extra) use the strategies in round robin,
+ * and the time of any call is measured. The results of fmgr and spi
+ * are compared with the result of direct (the direct is the reference),
+ * and a strategy with different result is not used. After sampling
+ * the strategy with shortest call (the minimum is more stable than
+ * average) is used for all next calls.
+ *
+ * The strategy can be forced by simple.adaptive_strategy. The number
+ * of samples and chosen strategies (in this backend) are returned by
+ * simple_adaptive_stats().
+ *
+ *-------------------------------------------------------------------------
+ */
+
+#include "postgres.h"
+#include "varatt.h"
+
+#include "catalog/pg_type.h"
+#include "executor/spi.h"
+#include "funcapi.h"
+#include "portability/instr_time.h"
+#include "utils/builtins.h"
+#include "utils/datum.h"
+#include "utils/guc.h"
+
+#include "simple.h"
+#include "spi_wait.h"
+
+PG_FUNCTION_INFO_V1(text_func_adaptive);
+PG_FUNCTION_INFO_V1(simple_adaptive_stats);
+PG_FUNCTION_INFO_V1(simple_adaptive_stats_reset);
+
+typedef enum AdaptiveStrategy
+{
+	ADAPTIVE_AUTO = -1,
+	ADAPTIVE_DIRECT,
+	ADAPTIVE_FMGR,
+	ADAPTIVE_SPI
+} AdaptiveStrategy;
+
+#define ADAPTIVE_NSTRATEGIES		3
+
+static const char *const strategy_names[] = {"direct", "fmgr", "spi"};
+
+static const struct config_enum_entry strategy_options[] = {
+	{"auto", ADAPTIVE_AUTO, false},
+	{"direct", ADAPTIVE_DIRECT, false},
+	{"fmgr", ADAPTIVE_FMGR, false},
+	{"spi", ADAPTIVE_SPI, false},
+	{NULL, 0, false}
+};
+
+static int	adaptive_strategy = ADAPTIVE_AUTO;
+static int	adaptive_samples = 30;
+
+typedef struct AdaptiveCache
+{
+	int			strategy;		/* ADAPTIVE_AUTO while sampling */
+	int			nsamples;
+	bool		correct[ADAPTIVE_NSTRATEGIES];
+	double		best_time[ADAPTIVE_NSTRATEGIES];	/* in us, -1 not measured */
+	text	   *suffix;			/* suffix as text value */
+} AdaptiveCache;
+
+typedef struct AdaptiveStats
+{
+	int64		samples;
+	double		sample_time;	/* in us */
+	int64		chosen;			/* chosen after sampling */
+	int64		calls;			/* calls after sampling (or forced) */
+} AdaptiveStats;
+
+/* statistics of this backend */
+static AdaptiveStats adaptive_stats[ADAPTIVE_NSTRATEGIES];
+
+/* the plan is shared by all queries */
+static SPIPlanPtr spi_plan = NULL;
+
+static text *
+eval_direct(text *t)
+{
+	const char *suffix;
+	int			suffix_len;
+
+	suffix = get_text_func_suffix(&suffix_len);
+
+	return text_func_concat(VARDATA_ANY(t), VARSIZE_ANY_EXHDR(t),
+							suffix, suffix_len);
+}
+
+static text *
+eval_fmgr(AdaptiveCache *cache, text *t)
+{
+	return DatumGetTextPP(DirectFunctionCall2(textcat,
+											  PointerGetDatum(t),
+											  PointerGetDatum(cache->suffix)));
+}
+
+static text *
+eval_spi(AdaptiveCache *cache, text *t)
+{
+	MemoryContext call_cxt = CurrentMemoryContext;
+	MemoryContext oldcxt;
+	Datum		values[2];
+	Datum		result;
+	bool		isnull;
+	int			res;
+
+	SPI_connect();
+
+	if (!spi_plan)
+	{
+		Oid			argtypes[2] = {TEXTOID, TEXTOID};
+		SPIPlanPtr	plan;
+
+		plan = SPI_prepare("SELECT $1 || $2", 2, argtypes);
+		if (!plan)
+			elog(ERROR, "SPI_prepare failed: %s",
+				 SPI_result_code_string(SPI_result));
+
+		SPI_keepplan(plan);
+		spi_plan = plan;
+	}
+
+	values[0] = PointerGetDatum(t);
+	values[1] = PointerGetDatum(cache->suffix);
+
+	pgstat_report_wait_start(simple_spi_wait_event());
+
+	res = SPI_execute_plan(spi_plan, values, NULL, true, 1);
+
+	pgstat_report_wait_end();
+
+	if (res != SPI_OK_SELECT || SPI_processed != 1)
+		elog(ERROR, "unexpected result of SPI query");
+
+	result = SPI_getbinval(SPI_tuptable->vals[0], SPI_tuptable->tupdesc,
+						   1, &isnull);
+	if (isnull)
+		elog(ERROR, "unexpected null");
+
+	oldcxt = MemoryContextSwitchTo(call_cxt);
+	result = datumCopy(result, false, -1);
+	MemoryContextSwitchTo(oldcxt);
+
+	SPI_finish();
+
+	return DatumGetTextPP(result);
+}
+
+static text *
+adaptive_eval(AdaptiveCache *cache, int strategy, text *t)
+{
+	switch (strategy)
+	{
+		case ADAPTIVE_DIRECT:
+			return eval_direct(t);
+		case ADAPTIVE_FMGR:
+			return eval_fmgr(cache, t);
+		case ADAPTIVE_SPI:
+			return eval_spi(cache, t);
+	}
+
+	elog(ERROR, "unknown strategy %d", strategy);
+
+	return NULL;				/* keep compiler quiet */
+}
+
+/*
+ * Chooses the correct strategy with shortest call
+ */
+static void
+adaptive_choose(AdaptiveCache *cache)
+{
+	int			best = ADAPTIVE_DIRECT;
+
+	for (int i = 0; i < ADAPTIVE_NSTRATEGIES; i++)
+	{
+		if (!cache->correct[i] || cache->best_time[i] < 0)
+			continue;
+
+		if (cache->best_time[i] < cache->best_time[best])
+			best = i;
+	}
+
+	cache->strategy = best;
+	adaptive_stats[best].chosen += 1;
+
+	elog(DEBUG1, "text_func_adaptive uses strategy \"%s\"", strategy_names[best]);
+}
+
+static text *
+adaptive_sample(AdaptiveCache *cache, text *t)
+{
+	int			strategy = cache->nsamples % ADAPTIVE_NSTRATEGIES;
+	instr_time	start;
+	instr_time	duration;
+	text	   *result;
+	double		time;
+
+	if (!cache->correct[strategy])
+		strategy = ADAPTIVE_DIRECT;
+
+	INSTR_TIME_SET_CURRENT(start);
+
+	result = adaptive_eval(cache, strategy, t);
+
+	INSTR_TIME_SET_CURRENT(duration);
+	INSTR_TIME_SUBTRACT(duration, start);
+
+	time = INSTR_TIME_GET_MILLISEC(duration) * 1000.0;
+
+	if (strategy != ADAPTIVE_DIRECT)
+	{
+		text	   *expected = eval_direct(t);
+
+		if (VARSIZE_ANY_EXHDR(result) != VARSIZE_ANY_EXHDR(expected) ||
+			memcmp(VARDATA_ANY(result), VARDATA_ANY(expected),
+				   VARSIZE_ANY_EXHDR(expected)) != 0)
+		{
+			elog(DEBUG1, "text_func_adaptive strategy \"%s\" returns wrong result",
+				 strategy_names[strategy]);
+
+			cache->correct[strategy] = false;
+			result = expected;
+		}
+	}
+
+	if (cache->best_time[strategy] < 0 || time < cache->best_time[strategy])
+		cache->best_time[strategy] = time;
+
+	adaptive_stats[strategy].samples += 1;
+	adaptive_stats[strategy].sample_time += time;
+
+	if (++cache->nsamples >= adaptive_samples)
+		adaptive_choose(cache);
+
+	return result;
+}
+
+/*
+ * Returns same result like text_func (without NOTICE)
+ */
+Datum
+text_func_adaptive(PG_FUNCTION_ARGS)
+{
+	text	   *t = PG_GETARG_TEXT_PP(0);
+	AdaptiveCache *cache = (AdaptiveCache *) fcinfo->flinfo->fn_extra;
+	int			strategy;
+	text	   *result;
+
+	if (!cache)
+	{
+		const char *suffix;
+		int			suffix_len;
+		MemoryContext oldcxt;
+
+		oldcxt = MemoryContextSwitchTo(fcinfo->flinfo->fn_mcxt);
+
+		cache = palloc0(sizeof(AdaptiveCache));
+		cache->strategy = ADAPTIVE_AUTO;
+
+		for (int i = 0; i < ADAPTIVE_NSTRATEGIES; i++)
+		{
+			cache->correct[i] = true;
+			cache->best_time[i] = -1;
+		}
+
+		suffix = get_text_func_suffix(&suffix_len);
+		cache->suffix = cstring_to_text_with_len(suffix, suffix_len);
+
+		MemoryContextSwitchTo(oldcxt);
+
+		fcinfo->flinfo->fn_extra = cache;
+	}
+
+	if (adaptive_strategy != ADAPTIVE_AUTO)
+		strategy = adaptive_strategy;
+	else if (cache->strategy != ADAPTIVE_AUTO)
+		strategy = cache->strategy;
+	else
+		PG_RETURN_TEXT_P(adaptive_sample(cache, t));
+
+	result = adaptive_eval(cache, strategy, t);
+	adaptive_stats[strategy].calls += 1;
+
+	PG_RETURN_TEXT_P(result);
+}
+
+Datum
+simple_adaptive_stats(PG_FUNCTION_ARGS)
+{
+	ReturnSetInfo *rsinfo = (ReturnSetInfo *) fcinfo->resultinfo;
+
+	InitMaterializedSRF(fcinfo, 0);
+
+	for (int i = 0; i < ADAPTIVE_NSTRATEGIES; i++)
+	{
+		AdaptiveStats *stats = &adaptive_stats[i];
+		Datum		values[5];
+		bool		nulls[5] = {0};
+
+		values[0] = CStringGetTextDatum(strategy_names[i]);
+		values[1] = Int64GetDatum(stats->samples);
+
+		if (stats->samples > 0)
+			values[2] = Float8GetDatum(stats->sample_time / stats->samples);
+		else
+			nulls[2] = true;
+
+		values[3] = Int64GetDatum(stats->chosen);
+		values[4] = Int64GetDatum(stats->calls);
+
+		tuplestore_putvalues(rsinfo->setResult, rsinfo->setDesc, values, nulls);
+	}
+
+	return (Datum) 0;
+}
+
+Datum
+simple_adaptive_stats_reset(PG_FUNCTION_ARGS)
+{
+	memset(adaptive_stats, 0, sizeof(adaptive_stats));
+
+	PG_RETURN_VOID();
+}
+
+void
+simple_adaptive_init(void)
+{
+	DefineCustomEnumVariable("simple.adaptive_strategy",
+							 "Forces the strategy of text_func_adaptive.",
+							 "The value auto selects the fastest strategy by measuring.",
+							 &adaptive_strategy,
+							 ADAPTIVE_AUTO,
+							 strategy_options,
+							 PGC_USERSET,
+							 0,
+							 NULL, NULL, NULL);
+
+	DefineCustomIntVariable("simple.adaptive_samples",
+							"Sets the number of measured calls of text_func_adaptive.",
+							NULL,
+							&adaptive_samples,
+							30,
+							ADAPTIVE_NSTRATEGIES,
+							10000,
+							PGC_USERSET,
+							0,
+							NULL, NULL, NULL);
+}
@@ -0,0 +1,640 @@
+/*-------------------------------------------------------------------------
+ *
+ * simple
+ *	  simple demo extension - batch evaluation of int_func
+ *
+ * Author:	Pavel Stehule
+ * Postcardware licence @2024
+ *
+ * IDENTIFICATION
+ *	  batch_scan.c
+ *
+ * The custom scan provider recognizes queries like
+ *
+ *     SELECT int_func(col), ... FROM tbl WHERE ...
+ *
+ * and instead of calling int_func for every row (by executor and fmgr)
+ * it reads a block of tuples, deforms them, copies the arguments to
+ * contiguous int32 array and does same computation like int_func_kernel
+ * over this array in one loop (vectorized by compiler). Then the rows
+ * are emitted.
+ *
+ *-------------------------------------------------------------------------
+ */
+
+#include "postgres.h"
+
+#include "access/table.h"
+#include "access/tableam.h"
+#include "catalog/pg_class.h"
+#include "catalog/pg_type.h"
+#include "executor/executor.h"
+#include "nodes/extensible.h"
+#include "optimizer/cost.h"
+#include "optimizer/pathnode.h"
+#include "optimizer/paths.h"
+#include "optimizer/restrictinfo.h"
+#include "utils/guc.h"
+#include "utils/rel.h"
+
+#include "simple.h"
+
+#define BATCH_SCAN_SIZE		1024
+
+typedef struct BatchColumn
+{
+	bool		is_int_func;	/* int_func(col) or just col */
+	AttrNumber	attno;			/* attribute of scanned relation */
+	int32	   *values;			/* arguments, and then results of int_func */
+} BatchColumn;
+
+typedef struct BatchScanState
+{
+	CustomScanState css;
+
+	bool		batched;		/* target list is evaluated by batch */
+	int			ncolumns;
+	BatchColumn *columns;
+	AttrNumber	maxattno;		/* last attribute that should be deformed */
+
+	TupleTableSlot **rows;		/* tuples of current batch */
+	int			nrows;
+	int			next;			/* next row for emitting */
+	int			overflow_row;	/* first row with overflow, or nrows */
+	bool		eof;
+} BatchScanState;
+
+static bool enable_batch_scan = true;
+
+static set_rel_pathlist_hook_type prev_set_rel_pathlist_hook = NULL;
+
+static Plan *batch_scan_plan_path(PlannerInfo *root, RelOptInfo *rel,
+								  CustomPath *best_path, List *tlist,
+								  List *clauses, List *custom_plans);
+static Node *batch_scan_create_state(CustomScan *cscan);
+static void batch_scan_begin(CustomScanState *node, EState *estate, int eflags);
+static TupleTableSlot *batch_scan_exec(CustomScanState *node);
+static void batch_scan_end(CustomScanState *node);
+static void batch_scan_rescan(CustomScanState *node);
+
+static const CustomPathMethods batch_scan_path_methods = {
+	.CustomName = "SimpleBatchScan",
+	.PlanCustomPath = batch_scan_plan_path,
+};
+
+static const CustomScanMethods batch_scan_plan_methods = {
+	.CustomName = "SimpleBatchScan",
+	.CreateCustomScanState = batch_scan_create_state,
+};
+
+static const CustomExecMethods batch_scan_exec_methods = {
+	.CustomName = "SimpleBatchScan",
+	.BeginCustomScan = batch_scan_begin,
+	.ExecCustomScan = batch_scan_exec,
+	.EndCustomScan = batch_scan_end,
+	.ReScanCustomScan = batch_scan_rescan,
+};
+
+/*
+ * Returns true, when var is an user column of scanned relation
+ */
+static bool
+is_scan_column(Var *var, Index scanrelid)
+{
+	return var->varno == scanrelid &&
+		   var->varlevelsup == 0 &&
+		   var->varattno > 0;
+}
+
+/*
+ * When expr is int_func(col), returns attribute number of col,
+ * else returns InvalidAttrNumber. The function is identified by
+ * address of C function, so the name or the schema of SQL function
+ * is not important.
+ */
+static AttrNumber
+int_func_column(Node *expr, Index scanrelid)
+{
+	FuncExpr   *fexpr;
+	Var		   *var;
+	FmgrInfo	finfo;
+
+	if (!IsA(expr, FuncExpr))
+		return InvalidAttrNumber;
+
+	fexpr = (FuncExpr *) expr;
+
+	if (fexpr->funcresulttype != INT4OID ||
+		fexpr->funcretset ||
+		list_length(fexpr->args) != 1)
+		return InvalidAttrNumber;
+
+	var = (Var *) linitial(fexpr->args);
+
+	if (!IsA(var, Var) ||
+		var->vartype != INT4OID ||
+		!is_scan_column(var, scanrelid))
+		return InvalidAttrNumber;
+
+	fmgr_info(fexpr->funcid, &finfo);
+
+	if (finfo.fn_addr != int_func)
+		return InvalidAttrNumber;
+
+	return var->varattno;
+}
+
+/*
+ * Is the relation stored by heap access method? We use heap's
+ * slots for rows of batch.
+ */
+static bool
+is_heap_relation(Oid relid)
+{
+	Relation	rel;
+	bool		result;
+
+	rel = table_open(relid, NoLock);
+	result = rel->rd_tableam == GetHeapamTableAmRoutine();
+	table_close(rel, NoLock);
+
+	return result;
+}
+
+/*
+ * Adds custom path for simple SELECT over one table, when
+ * int_func(col) is in target list.
+ */
+static void
+batch_scan_set_rel_pathlist(PlannerInfo *root,
+							RelOptInfo *rel,
+							Index rti,
+							RangeTblEntry *rte)
+{
+	Query	   *parse = root->parse;
+	Path	   *seqpath = NULL;
+	CustomPath *cpath;
+	bool		found = false;
+	ListCell   *lc;
+
+	if (prev_set_rel_pathlist_hook)
+		(*prev_set_rel_pathlist_hook) (root, rel, rti, rte);
+
+	if (!enable_batch_scan)
+		return;
+
+	/*
+	 * The target list is evaluated by scan node only for simple
+	 * queries without joins, aggregations or window functions.
+	 */
+	if (rel->reloptkind != RELOPT_BASEREL ||
+		rte->rtekind != RTE_RELATION ||
+		rte->relkind != RELKIND_RELATION ||
+		rte->inh ||
+		rte->tablesample ||
+		parse->commandType != CMD_SELECT ||
+		parse->rowMarks != NIL ||
+		parse->hasAggs ||
+		parse->groupClause != NIL ||
+		parse->groupingSets != NIL ||
+		parse->hasWindowFuncs ||
+		parse->hasTargetSRFs ||
+		bms_membership(root->all_baserels) != BMS_SINGLETON)
+		return;
+
+	foreach(lc, parse->targetList)
+	{
+		TargetEntry *tle = lfirst_node(TargetEntry, lc);
+
+		if (int_func_column((Node *) tle->expr, rti) != InvalidAttrNumber)
+		{
+			found = true;
+			break;
+		}
+	}
+
+	if (!found || !is_heap_relation(rte->relid))
+		return;
+
+	foreach(lc, rel->pathlist)
+	{
+		Path	   *path = (Path *) lfirst(lc);
+
+		if (path->pathtype == T_SeqScan &&
+			path->param_info == NULL &&
+			!path->parallel_aware)
+		{
+			seqpath = path;
+			break;
+		}
+	}
+
+	if (!seqpath)
+		return;
+
+	cpath = makeNode(CustomPath);
+
+	cpath->path.pathtype = T_CustomScan;
+	cpath->path.parent = rel;
+	cpath->path.pathtarget = rel->reltarget;
+	cpath->path.param_info = NULL;
+	cpath->path.parallel_aware = false;
+	cpath->path.parallel_safe = false;
+	cpath->path.parallel_workers = 0;
+	cpath->path.rows = seqpath->rows;
+	cpath->path.pathkeys = NIL;
+
+	/*
+	 * The scan itself costs same like seq scan. Batch evaluation
+	 * saves the overhead of function call, that is estimated as
+	 * half of cost of int_func call for every returned row.
+	 */
+	cpath->path.startup_cost = seqpath->startup_cost;
+	cpath->path.total_cost = Max(seqpath->startup_cost,
+								 seqpath->total_cost -
+								 seqpath->rows * cpu_operator_cost * 0.5);
+
+	cpath->flags = CUSTOMPATH_SUPPORT_PROJECTION;
+	cpath->custom_paths = NIL;
+	cpath->custom_private = NIL;
+	cpath->methods = &batch_scan_path_methods;
+
+	add_path(rel, &cpath->path);
+}
+
+static Plan *
+batch_scan_plan_path(PlannerInfo *root,
+					 RelOptInfo *rel,
+					 CustomPath *best_path,
+					 List *tlist,
+					 List *clauses,
+					 List *custom_plans)
+{
+	CustomScan *cscan = makeNode(CustomScan);
+
+	/*
+	 * Usually tlist is NIL here, and the final target list (with
+	 * int_func) is assigned by planner later. So the decision about
+	 * batch evaluation is done in executor.
+	 */
+	cscan->scan.plan.targetlist = tlist;
+	cscan->scan.plan.qual = extract_actual_clauses(clauses, false);
+	cscan->scan.scanrelid = rel->relid;
+
+	cscan->flags = best_path->flags;
+	cscan->custom_plans = NIL;
+	cscan->custom_exprs = NIL;
+	cscan->custom_private = NIL;
+	cscan->custom_scan_tlist = NIL;
+	cscan->methods = &batch_scan_plan_methods;
+
+	return &cscan->scan.plan;
+}
+
+static Node *
+batch_scan_create_state(CustomScan *cscan)
+{
+	BatchScanState *bss = palloc0(sizeof(BatchScanState));
+
+	NodeSetTag(bss, T_CustomScanState);
+
+	bss->css.methods = &batch_scan_exec_methods;
+
+	/* only heap relations are scanned (see is_heap_relation) */
+	bss->css.slotOps = &TTSOpsBufferHeapTuple;
+
+	return (Node *) bss;
+}
+
+/*
+ * Check if every target is int_func(col) or col. Any other expression
+ * disables batch evaluation, and then the tuples are processed one by
+ * one by ExecScan.
+ */
+static void
+batch_scan_begin(CustomScanState *node, EState *estate, int eflags)
+{
+	BatchScanState *bss = (BatchScanState *) node;
+	Plan	   *plan = node->ss.ps.plan;
+	Index		scanrelid = ((Scan *) plan)->scanrelid;
+	bool		supported = true;
+	bool		has_int_func = false;
+	ListCell   *lc;
+	int			i = 0;
+
+	bss->ncolumns = list_length(plan->targetlist);
+	bss->columns = palloc0(sizeof(BatchColumn) * bss->ncolumns);
+
+	foreach(lc, plan->targetlist)
+	{
+		TargetEntry *tle = lfirst_node(TargetEntry, lc);
+		BatchColumn *col = &bss->columns[i++];
+		AttrNumber	attno;
+
+		attno = int_func_column((Node *) tle->expr, scanrelid);
+
+		if (attno != InvalidAttrNumber)
+		{
+			col->is_int_func = true;
+			has_int_func = true;
+		}
+		else if (IsA(tle->expr, Var) &&
+				 is_scan_column((Var *) tle->expr, scanrelid))
+			attno = ((Var *) tle->expr)->varattno;
+		else
+		{
+			supported = false;
+			break;
+		}
+
+		col->attno = attno;
+		bss->maxattno = Max(bss->maxattno, attno);
+	}
+
+	bss->batched = supported && has_int_func;
+
+	if (bss->batched && !(eflags & EXEC_FLAG_EXPLAIN_ONLY))
+	{
+		Relation	rel = node->ss.ss_currentRelation;
+
+		for (i = 0; i < bss->ncolumns; i++)
+		{
+			if (bss->columns[i].is_int_func)
+				bss->columns[i].values = palloc(sizeof(int32) * BATCH_SCAN_SIZE);
+		}
+
+		/*
+		 * Every row of batch has own slot, so the tuples stay pinned
+		 * in buffers and the values need not be copied. The slots
+		 * are released by executor.
+		 */
+		bss->rows = palloc(sizeof(TupleTableSlot *) * BATCH_SCAN_SIZE);
+		for (i = 0; i < BATCH_SCAN_SIZE; i++)
+			bss->rows[i] = table_slot_create(rel, &estate->es_tupleTable);
+	}
+}
+
+/*
+ * Scan is started lazily like in seq scan.
+ */
+static TableScanDesc
+batch_scan_desc(ScanState *node)
+{
+	if (!node->ss_currentScanDesc)
+		node->ss_currentScanDesc = table_beginscan(node->ss_currentRelation,
+												   node->ps.state->es_snapshot,
+												   0, NULL);
+
+	return node->ss_currentScanDesc;
+}
+
+/*
+ * Access method for row by row processing by ExecScan
+ */
+static TupleTableSlot *
+batch_scan_next(ScanState *node)
+{
+	TableScanDesc scandesc = batch_scan_desc(node);
+	TupleTableSlot *slot = node->ss_ScanTupleSlot;
+
+	if (table_scan_getnextslot(scandesc, ForwardScanDirection, slot))
+		return slot;
+
+	return NULL;
+}
+
+static bool
+batch_scan_recheck(ScanState *node, TupleTableSlot *slot)
+{
+	return true;
+}
+
+/*
+ * The same operation like int_func_kernel, but over an array. The loop
+ * is written without branches and overflow builtins, so it can be
+ * vectorized by compiler (the file is compiled with CFLAGS_VECTORIZE).
+ * Returns the index of first row, that overflows, or n. The rare
+ * overflow is searched by second loop.
+ */
+static int
+int_func_batch(int32 *values, int n)
+{
+	int			overflow = 0;
+	int			i;
+
+	for (i = 0; i < n; i++)
+	{
+		overflow |= values[i] > PG_INT32_MAX - INT_FUNC_INCREMENT;
+		values[i] = (int32) ((uint32) values[i] + INT_FUNC_INCREMENT);
+	}
+
+	if (overflow == 0)
+		return n;
+
+	for (i = 0; i < n; i++)
+	{
+		/* the result wrapped around */
+		if (values[i] < PG_INT32_MIN + INT_FUNC_INCREMENT)
+			return i;
+	}
+
+	return n;
+}
+
+/*
+ * Reads next block of tuples that satisfy quals, and evaluates
+ * int_func for all of them. Returns false when there are not
+ * any other tuples. The overflow is not raised here, but when the
+ * row is emitted, so the rows before are returned like by scalar
+ * int_func (the query with LIMIT can finish without error).
+ */
+static bool
+batch_scan_fill(BatchScanState *bss)
+{
+	ScanState  *ss = &bss->css.ss;
+	ExprContext *econtext = ss->ps.ps_ExprContext;
+	ExprState  *qual = ss->ps.qual;
+	TableScanDesc scandesc;
+	int			nrows = 0;
+	int			i;
+
+	bss->nrows = 0;
+	bss->next = 0;
+	bss->overflow_row = 0;
+
+	if (bss->eof)
+		return false;
+
+	scandesc = batch_scan_desc(ss);
+
+	while (nrows < BATCH_SCAN_SIZE)
+	{
+		TupleTableSlot *slot = bss->rows[nrows];
+
+		CHECK_FOR_INTERRUPTS();
+
+		if (!table_scan_getnextslot(scandesc, ForwardScanDirection, slot))
+		{
+			bss->eof = true;
+			break;
+		}
+
+		if (qual)
+		{
+			ResetExprContext(econtext);
+			econtext->ecxt_scantuple = slot;
+
+			if (!ExecQual(qual, econtext))
+			{
+				InstrCountFiltered1(bss, 1);
+				continue;
+			}
+		}
+
+		slot_getsomeattrs(slot, bss->maxattno);
+		nrows += 1;
+	}
+
+	bss->overflow_row = nrows;
+
+	for (i = 0; i < bss->ncolumns; i++)
+	{
+		BatchColumn *col = &bss->columns[i];
+		int			attidx = col->attno - 1;
+		int			overflow_row;
+		int			j;
+
+		if (!col->is_int_func)
+			continue;
+
+		for (j = 0; j < nrows; j++)
+		{
+			TupleTableSlot *slot = bss->rows[j];
+
+			col->values[j] = slot->tts_isnull[attidx] ?
+				0 : DatumGetInt32(slot->tts_values[attidx]);
+		}
+
+		overflow_row = int_func_batch(col->values, nrows);
+		if (overflow_row < bss->overflow_row)
+			bss->overflow_row = overflow_row;
+	}
+
+	bss->nrows = nrows;
+
+	return nrows > 0;
+}
+
+/*
+ * Result tuple is virtual tuple. The values of passed columns
+ * are not copied - the source tuple is pinned by row's slot
+ * until next batch is read.
+ */
+static TupleTableSlot *
+batch_scan_emit(BatchScanState *bss, int row)
+{
+	TupleTableSlot *result = bss->css.ss.ps.ps_ResultTupleSlot;
+	TupleTableSlot *slot = bss->rows[row];
+	int			i;
+
+	if (row == bss->overflow_row)
+		ereport(ERROR,
+				(errcode(ERRCODE_NUMERIC_VALUE_OUT_OF_RANGE),
+				 errmsg("integer out of range")));
+
+	ExecClearTuple(result);
+
+	for (i = 0; i < bss->ncolumns; i++)
+	{
+		BatchColumn *col = &bss->columns[i];
+		int			attidx = col->attno - 1;
+
+		/* int_func is strict, NULL returns NULL */
+		result->tts_isnull[i] = slot->tts_isnull[attidx];
+
+		if (col->is_int_func)
+			result->tts_values[i] = Int32GetDatum(col->values[row]);
+		else
+			result->tts_values[i] = slot->tts_values[attidx];
+	}
+
+	return ExecStoreVirtualTuple(result);
+}
+
+static TupleTableSlot *
+batch_scan_exec(CustomScanState *node)
+{
+	BatchScanState *bss = (BatchScanState *) node;
+
+	if (!bss->batched)
+		return ExecScan(&node->ss,
+						batch_scan_next,
+						batch_scan_recheck);
+
+	if (bss->next >= bss->nrows)
+	{
+		if (!batch_scan_fill(bss))
+			return ExecClearTuple(node->ss.ps.ps_ResultTupleSlot);
+	}
+
+	return batch_scan_emit(bss, bss->next++);
+}
+
+static void
+batch_scan_release_rows(BatchScanState *bss)
+{
+	int			i;
+
+	for (i = 0; i < bss->nrows; i++)
+		ExecClearTuple(bss->rows[i]);
+
+	bss->nrows = 0;
+	bss->next = 0;
+	bss->overflow_row = 0;
+}
+
+static void
+batch_scan_end(CustomScanState *node)
+{
+	BatchScanState *bss = (BatchScanState *) node;
+
+	if (bss->batched)
+		batch_scan_release_rows(bss);
+
+	if (node->ss.ss_currentScanDesc)
+		table_endscan(node->ss.ss_currentScanDesc);
+}
+
+static void
+batch_scan_rescan(CustomScanState *node)
+{
+	BatchScanState *bss = (BatchScanState *) node;
+
+	if (bss->batched)
+		batch_scan_release_rows(bss);
+
+	bss->eof = false;
+
+	if (node->ss.ss_currentScanDesc)
+		table_rescan(node->ss.ss_currentScanDesc, NULL);
+
+	ExecScanReScan(&node->ss);
+}
+
+void
+simple_batch_scan_init(void)
+{
+	DefineCustomBoolVariable("simple.enable_batch_scan",
+							 "Enables batch evaluation of int_func by custom scan.",
+							 NULL,
+							 &enable_batch_scan,
+							 true,
+							 PGC_USERSET,
+							 0,
+							 NULL, NULL, NULL);
+
+	RegisterCustomScanMethods(&batch_scan_plan_methods);
+
+	prev_set_rel_pathlist_hook = set_rel_pathlist_hook;
+	set_rel_pathlist_hook = batch_scan_set_rel_pathlist;
+}
@@ -0,0 +1,357 @@
+/*-------------------------------------------------------------------------
+ *
+ * simple
+ *	  simple demo extension - bulk export and import in binary COPY format
+ *
+ * Author:	Pavel Stehule
+ * Postcardware licence @2024
+ *
+ * IDENTIFICATION
+ *	  copy_binary.c
+ *
+ * simple_copy_out executes a query by SPI cursor, and writes the result
+ * to server side file in binary format of COPY. The values are converted
+ * by send functions (without text formatting), and the data are written
+ * in large blocks. The file can be read by COPY FROM (FORMAT binary) or
+ * by simple_copy_in, that is thin wrapper of COPY FROM API.
+ *
+ * The format is described in documentation of COPY command:
+ *
+ *     header:  "PGCOPY\n\377\r\n\0", int32 flags, int32 extension length
+ *     tuple:   int16 fields, (int32 length, data) for any field,
+ *              length -1 is NULL
+ *     trailer: int16 -1
+ *
+ * All integers are in network byte order.
+ *
+ * The fetches from cursor are counted in SPI statistics (spi_stats.c)
+ * like executions.
+ *
+ *-------------------------------------------------------------------------
+ */
+
+#include "postgres.h"
+
+#include <fcntl.h>
+#include <unistd.h>
+
+#include "access/htup_details.h"
+#include "access/sysattr.h"
+#include "access/table.h"
+#include "catalog/pg_authid.h"
+#include "commands/copy.h"
+#include "executor/executor.h"
+#include "executor/spi.h"
+#include "libpq/pqformat.h"
+#include "miscadmin.h"
+#include "nodes/makefuncs.h"
+#include "parser/parse_relation.h"
+#include "portability/instr_time.h"
+#include "storage/fd.h"
+#include "tcop/utility.h"
+#include "utils/acl.h"
+#include "utils/builtins.h"
+#include "utils/lsyscache.h"
+#include "utils/memutils.h"
+#include "utils/rel.h"
+#include "utils/rls.h"
+
+#include "simple.h"
+#include "spi_wait.h"
+
+PG_FUNCTION_INFO_V1(simple_copy_out);
+PG_FUNCTION_INFO_V1(simple_copy_in);
+
+/* rows fetched from cursor by one fetch */
+#define COPY_FETCH_SIZE			1000
+
+/* the buffer is written when it is bigger than this size */
+#define COPY_BUFFER_SIZE		(1024 * 1024)
+
+static const char BinarySignature[11] = "PGCOPY\n\377\r\n\0";
+
+typedef struct CopyOutState
+{
+	const char *path;
+	int			fd;
+	off_t		offset;			/* position of buffer in file */
+	StringInfoData buf;
+} CopyOutState;
+
+static void
+copy_out_flush(CopyOutState *cstate)
+{
+	char	   *ptr = cstate->buf.data;
+	int			nbytes = cstate->buf.len;
+
+	while (nbytes > 0)
+	{
+		ssize_t		written;
+
+		written = write(cstate->fd, ptr, nbytes);
+		if (written < 0)
+		{
+			if (errno == EINTR)
+				continue;
+
+			ereport(ERROR,
+					(errcode_for_file_access(),
+					 errmsg("could not write to file \"%s\": %m",
+							cstate->path)));
+		}
+
+		ptr += written;
+		nbytes -= written;
+	}
+
+	/*
+	 * Ask the kernel to start writeback of written data. Without it
+	 * tens of GB of dirty pages can be in page cache, and they are
+	 * written at one time later (uses sync_file_range or posix_fadvise
+	 * when it is available).
+	 */
+	pg_flush_data(cstate->fd, cstate->offset, cstate->buf.len);
+
+	cstate->offset += cstate->buf.len;
+	resetStringInfo(&cstate->buf);
+}
+
+/*
+ * Runs the query and writes the result to the file in binary
+ * COPY format. Returns number of rows.
+ */
+Datum
+simple_copy_out(PG_FUNCTION_ARGS)
+{
+	char	   *query = text_to_cstring(PG_GETARG_TEXT_PP(0));
+	char	   *path = text_to_cstring(PG_GETARG_TEXT_PP(1));
+	CopyOutState cstate;
+	SPIPlanPtr	plan;
+	Portal		portal;
+	FmgrInfo   *send_finfos = NULL;
+	int			natts = 0;
+	MemoryContext row_cxt;
+	MemoryContext oldcxt;
+	int64		rows = 0;
+	int64		fetches = 0;
+	instr_time	spi_time;
+
+	/* same rules like COPY TO file */
+	if (!has_privs_of_role(GetUserId(), ROLE_PG_WRITE_SERVER_FILES))
+		ereport(ERROR,
+				(errcode(ERRCODE_INSUFFICIENT_PRIVILEGE),
+				 errmsg("permission denied to write to file"),
+				 errdetail("Only roles with privileges of the \"%s\" role may write to server files.",
+						   "pg_write_server_files")));
+
+	if (!is_absolute_path(path))
+		ereport(ERROR,
+				(errcode(ERRCODE_INVALID_NAME),
+				 errmsg("relative path not allowed for simple_copy_out")));
+
+	cstate.path = path;
+	cstate.offset = 0;
+	cstate.fd = OpenTransientFile(path, O_WRONLY | O_CREAT | O_TRUNC | PG_BINARY);
+	if (cstate.fd < 0)
+		ereport(ERROR,
+				(errcode_for_file_access(),
+				 errmsg("could not open file \"%s\" for writing: %m", path)));
+
+	initStringInfo(&cstate.buf);
+	enlargeStringInfo(&cstate.buf, COPY_BUFFER_SIZE + BLCKSZ);
+
+	/* header */
+	appendBinaryStringInfo(&cstate.buf, BinarySignature, sizeof(BinarySignature));
+	pq_sendint32(&cstate.buf, 0);
+	pq_sendint32(&cstate.buf, 0);
+
+	/*
+	 * The send functions allocate a memory for every value. This memory
+	 * is released after every row.
+	 */
+	row_cxt = AllocSetContextCreate(CurrentMemoryContext,
+									"simple_copy_out row context",
+									ALLOCSET_DEFAULT_SIZES);
+
+	SPI_connect();
+
+	plan = SPI_prepare(query, 0, NULL);
+	if (!plan)
+		elog(ERROR, "SPI_prepare failed: %s", SPI_result_code_string(SPI_result));
+
+	portal = SPI_cursor_open(NULL, plan, NULL, NULL, true);
+
+	INSTR_TIME_SET_ZERO(spi_time);
+
+	for (;;)
+	{
+		instr_time	start;
+		instr_time	end;
+
+		INSTR_TIME_SET_CURRENT(start);
+		pgstat_report_wait_start(simple_spi_wait_event());
+
+		SPI_cursor_fetch(portal, true, COPY_FETCH_SIZE);
+
+		pgstat_report_wait_end();
+		INSTR_TIME_SET_CURRENT(end);
+		INSTR_TIME_ACCUM_DIFF(spi_time, end, start);
+
+		fetches += 1;
+
+		if (SPI_processed == 0)
+			break;
+
+		/* the result descriptor is known after first fetch */
+		if (!send_finfos)
+		{
+			TupleDesc	tupdesc = SPI_tuptable->tupdesc;
+
+			natts = tupdesc->natts;
+			send_finfos = palloc0(sizeof(FmgrInfo) * natts);
+
+			for (int i = 0; i < natts; i++)
+			{
+				Form_pg_attribute attr = TupleDescAttr(tupdesc, i);
+				Oid			sendfunc;
+				bool		isvarlena;
+
+				if (attr->attisdropped)
+					continue;
+
+				getTypeBinaryOutputInfo(attr->atttypid, &sendfunc, &isvarlena);
+				fmgr_info(sendfunc, &send_finfos[i]);
+			}
+		}
+
+		for (uint64 i = 0; i < SPI_processed; i++)
+		{
+			HeapTuple	tuple = SPI_tuptable->vals[i];
+			TupleDesc	tupdesc = SPI_tuptable->tupdesc;
+
+			oldcxt = MemoryContextSwitchTo(row_cxt);
+
+			pq_sendint16(&cstate.buf, natts);
+
+			for (int j = 0; j < natts; j++)
+			{
+				Datum		value;
+				bool		isnull;
+
+				value = heap_getattr(tuple, j + 1, tupdesc, &isnull);
+
+				if (isnull)
+					pq_sendint32(&cstate.buf, -1);
+				else
+				{
+					bytea	   *outputbytes;
+
+					outputbytes = SendFunctionCall(&send_finfos[j], value);
+					pq_sendint32(&cstate.buf, VARSIZE(outputbytes) - VARHDRSZ);
+					appendBinaryStringInfo(&cstate.buf,
+										   VARDATA(outputbytes),
+										   VARSIZE(outputbytes) - VARHDRSZ);
+				}
+			}
+
+			MemoryContextSwitchTo(oldcxt);
+			MemoryContextReset(row_cxt);
+
+			if (cstate.buf.len >= COPY_BUFFER_SIZE)
+				copy_out_flush(&cstate);
+
+			rows += 1;
+		}
+
+		SPI_freetuptable(SPI_tuptable);
+	}
+
+	SPI_cursor_close(portal);
+	SPI_finish();
+
+	simple_spi_stats_report(fcinfo->flinfo->fn_oid, fetches, rows, spi_time);
+
+	/* trailer */
+	pq_sendint16(&cstate.buf, -1);
+	copy_out_flush(&cstate);
+
+	if (CloseTransientFile(cstate.fd) != 0)
+		ereport(ERROR,
+				(errcode_for_file_access(),
+				 errmsg("could not close file \"%s\": %m", path)));
+
+	MemoryContextDelete(row_cxt);
+
+	PG_RETURN_INT64(rows);
+}
+
+/*
+ * Loads the file in binary COPY format to the table. It does same
+ * checks like COPY FROM file.
+ */
+Datum
+simple_copy_in(PG_FUNCTION_ARGS)
+{
+	Oid			relid = PG_GETARG_OID(0);
+	char	   *path = text_to_cstring(PG_GETARG_TEXT_PP(1));
+	ParseState *pstate;
+	ParseNamespaceItem *nsitem;
+	RTEPermissionInfo *perminfo;
+	Relation	rel;
+	TupleDesc	tupdesc;
+	CopyFromState cstate;
+	List	   *options;
+	uint64		processed;
+
+	if (!has_privs_of_role(GetUserId(), ROLE_PG_READ_SERVER_FILES))
+		ereport(ERROR,
+				(errcode(ERRCODE_INSUFFICIENT_PRIVILEGE),
+				 errmsg("permission denied to read from file"),
+				 errdetail("Only roles with privileges of the \"%s\" role may read from server files.",
+						   "pg_read_server_files")));
+
+	/* same checks like COPY FROM (on standby the transaction is read only) */
+	PreventCommandIfReadOnly("simple_copy_in()");
+	PreventCommandIfParallelMode("simple_copy_in()");
+
+	rel = table_open(relid, RowExclusiveLock);
+
+	if (check_enable_rls(relid, InvalidOid, false) == RLS_ENABLED)
+		ereport(ERROR,
+				(errcode(ERRCODE_FEATURE_NOT_SUPPORTED),
+				 errmsg("simple_copy_in is not supported with row-level security")));
+
+	pstate = make_parsestate(NULL);
+
+	/* COPY FROM API requires range table with target relation */
+	nsitem = addRangeTableEntryForRelation(pstate, rel, RowExclusiveLock,
+										   NULL, false, false);
+	perminfo = nsitem->p_perminfo;
+	perminfo->requiredPerms = ACL_INSERT;
+
+	tupdesc = RelationGetDescr(rel);
+	for (int i = 0; i < tupdesc->natts; i++)
+	{
+		Form_pg_attribute attr = TupleDescAttr(tupdesc, i);
+
+		if (attr->attisdropped)
+			continue;
+
+		perminfo->insertedCols =
+			bms_add_member(perminfo->insertedCols,
+						   attr->attnum - FirstLowInvalidHeapAttributeNumber);
+	}
+
+	ExecCheckPermissions(pstate->p_rtable, list_make1(perminfo), true);
+
+	options = list_make1(makeDefElem("format", (Node *) makeString("binary"), -1));
+
+	cstate = BeginCopyFrom(pstate, rel, NULL, path, false, NULL, NIL, options);
+	processed = CopyFrom(cstate);
+	EndCopyFrom(cstate);
+
+	free_parsestate(pstate);
+	table_close(rel, NoLock);
+
+	PG_RETURN_INT64((int64) processed);
+}
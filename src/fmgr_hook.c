@@ -0,0 +1,412 @@
+/*-------------------------------------------------------------------------
+ *
+ * simple
+ *	  simple demo extension - instrumentation of functions by fmgr hook
+ *
+ * Author:	Pavel Stehule
+ * Postcardware licence @2024
+ *
+ * IDENTIFICATION
+ *	  fmgr_hook.c
+ *
+ * The fmgr hook (see lesson simple_10.c) is used for instrumentation
+ * of the extension's functions int_func and text_func. When the
+ * memory accounting is enabled (simple.track_memory), any call of
+ * hooked function is executed inside own child memory context. After
+ * call the size of this context is an allocated memory by the call.
+ * The context is released together with its parent (usually per tuple
+ * context). Contexts that live long time (memory that survives the
+ * call in long life contexts) are the source of memory growth.
+ *
+ * When tracing is enabled (simple.trace_calls), the start, end and abort
+ * of any call is written to ring buffer in shared memory (trace.c).
+ * When simple.track_queries is on, the time of calls is measured, and
+ * it is attributed to the query (query_stats.c).
+ *
+ * Attention - the hook is used only for functions that are looked up
+ * after enabling of instrumentation (fmgr_info caches the decision).
+ *
+ *-------------------------------------------------------------------------
+ */
+
+#include "postgres.h"
+
+#include "funcapi.h"
+#include "portability/instr_time.h"
+#include "utils/guc.h"
+#include "utils/hsearch.h"
+#include "utils/memutils.h"
+
+#include "proname_cache.h"
+#include "simple.h"
+
+PG_FUNCTION_INFO_V1(simple_memory_stats);
+PG_FUNCTION_INFO_V1(simple_memory_stats_reset);
+
+static needs_fmgr_hook_type prev_needs_fmgr_hook = NULL;
+static fmgr_hook_type prev_fmgr_hook = NULL;
+
+static bool track_memory = false;
+
+/* oids of hooked functions (int_func has overloads) */
+static const char *hooked_names[] = {"int_func", "text_func"};
+static PronameCache hooked_oids = {lengthof(hooked_names), hooked_names};
+
+#define SIMPLE_MAGIC		2024100316
+
+typedef struct CallContextInfo
+{
+	MemoryContextCallback cb;
+	Oid			fn_oid;
+	uint64		generation;		/* generation of memory stats */
+	bool		counted;		/* the context is counted as live */
+	int64		bytes;
+} CallContextInfo;
+
+typedef struct
+{
+	int			magic;
+	bool		is_hooked;
+	int			depth;			/* nesting level of calls */
+	MemoryContext call_cxt;		/* context of active call */
+	MemoryContext caller_cxt;	/* memory context of caller */
+	int64		call_base;		/* size of empty call context */
+	CallContextInfo *call_info;
+	bool		timed;			/* start_time is valid */
+	instr_time	start_time;		/* start of outer call */
+	Datum		prev_arg;
+} simple_fmgr_cache;
+
+typedef struct MemoryStatsEntry
+{
+	Oid			fn_oid;			/* hash key */
+	int64		calls;
+	int64		total_bytes;
+	int64		peak_bytes;		/* the biggest allocation of one call */
+	int64		live_contexts;	/* not released call contexts */
+	int64		live_bytes;		/* memory held by not released contexts */
+	int64		max_live_bytes;
+} MemoryStatsEntry;
+
+static HTAB *memory_stats = NULL;
+static uint64 memory_stats_generation = 0;
+
+static bool
+is_hooked_oid(Oid fn_oid)
+{
+	return list_member_oid(hooked_oids.oids[0], fn_oid) ||
+		list_member_oid(hooked_oids.oids[1], fn_oid);
+}
+
+static bool
+simple_needs_fmgr_hook(Oid fn_oid)
+{
+	if (prev_needs_fmgr_hook &&
+		(*prev_needs_fmgr_hook) (fn_oid))
+		return true;
+
+	if (!track_memory && !simple_trace_calls && !simple_track_queries)
+		return false;
+
+	/* errors are not allowed in fmgr hook, so attach shared memory now */
+	if (simple_trace_calls)
+		simple_trace_attach();
+	if (simple_track_queries)
+		simple_query_stats_attach();
+
+	/*
+	 * The names are searched again only after change of search_path
+	 * or pg_proc. When the extension is not created yet, nothing is
+	 * hooked.
+	 */
+	if (!proname_cache_valid(&hooked_oids) &&
+		!proname_cache_refresh(&hooked_oids))
+		return false;
+
+	return is_hooked_oid(fn_oid);
+}
+
+static MemoryStatsEntry *
+memory_stats_entry(Oid fn_oid)
+{
+	MemoryStatsEntry *entry;
+	bool		found;
+
+	if (!memory_stats)
+	{
+		HASHCTL		ctl;
+
+		ctl.keysize = sizeof(Oid);
+		ctl.entrysize = sizeof(MemoryStatsEntry);
+		ctl.hcxt = TopMemoryContext;
+
+		memory_stats = hash_create("simple memory stats",
+								   64,
+								   &ctl,
+								   HASH_ELEM | HASH_BLOBS | HASH_CONTEXT);
+	}
+
+	entry = hash_search(memory_stats, &fn_oid, HASH_ENTER, &found);
+	if (!found)
+	{
+		memset(entry, 0, sizeof(MemoryStatsEntry));
+		entry->fn_oid = fn_oid;
+	}
+
+	return entry;
+}
+
+/*
+ * Called when the call's context is deleted (usually together with
+ * its parent).
+ */
+static void
+call_context_released(void *arg)
+{
+	CallContextInfo *info = (CallContextInfo *) arg;
+	MemoryStatsEntry *entry;
+
+	if (!info->counted ||
+		!memory_stats ||
+		info->generation != memory_stats_generation)
+		return;
+
+	entry = hash_search(memory_stats, &info->fn_oid, HASH_FIND, NULL);
+	if (entry)
+	{
+		entry->live_contexts -= 1;
+		entry->live_bytes -= info->bytes;
+	}
+}
+
+static void
+memory_accounting_start(simple_fmgr_cache *fcache, FmgrInfo *flinfo)
+{
+	CallContextInfo *info;
+
+	fcache->caller_cxt = CurrentMemoryContext;
+	fcache->call_cxt = AllocSetContextCreate(CurrentMemoryContext,
+											 "simple call context",
+											 ALLOCSET_SMALL_SIZES);
+
+	info = MemoryContextAlloc(fcache->call_cxt, sizeof(CallContextInfo));
+	info->fn_oid = flinfo->fn_oid;
+	info->generation = memory_stats_generation;
+	info->counted = false;
+	info->bytes = 0;
+	info->cb.func = call_context_released;
+	info->cb.arg = info;
+
+	MemoryContextRegisterResetCallback(fcache->call_cxt, &info->cb);
+
+	fcache->call_info = info;
+	fcache->call_base = MemoryContextMemAllocated(fcache->call_cxt, true);
+
+	MemoryContextSwitchTo(fcache->call_cxt);
+}
+
+static void
+memory_accounting_end(simple_fmgr_cache *fcache)
+{
+	CallContextInfo *info = fcache->call_info;
+	MemoryStatsEntry *entry;
+	int64		bytes;
+
+	MemoryContextSwitchTo(fcache->caller_cxt);
+
+	bytes = MemoryContextMemAllocated(fcache->call_cxt, true) - fcache->call_base;
+
+	entry = memory_stats_entry(info->fn_oid);
+
+	entry->calls += 1;
+	entry->total_bytes += bytes;
+	entry->peak_bytes = Max(entry->peak_bytes, bytes);
+
+	/*
+	 * The context cannot be released now, it holds the result. It will
+	 * be released with its parent context.
+	 */
+	info->bytes = bytes;
+	info->counted = true;
+
+	entry->live_contexts += 1;
+	entry->live_bytes += bytes;
+	entry->max_live_bytes = Max(entry->max_live_bytes, entry->live_bytes);
+
+	fcache->call_cxt = NULL;
+	fcache->call_info = NULL;
+}
+
+/*
+ * Inside hooks we should to think about other extensions
+ * that can to use same hook.
+ */
+static void
+simple_fmgr_hook(FmgrHookEventType event,
+				 FmgrInfo *flinfo, Datum *private)
+{
+	simple_fmgr_cache *fcache = (simple_fmgr_cache *) DatumGetPointer(*private);
+
+	/*
+	 * fmgr hook events should be executed in an order
+	 * START, END | ABORT. But the extension can be initialized
+	 * inside an function, and then START can missing. Theoretically
+	 * the hook can be called with private data of another extension.
+	 */
+	if ((!fcache && event != FHET_START) ||
+		(fcache && fcache->magic != SIMPLE_MAGIC))
+	{
+		if (prev_fmgr_hook)
+			(*prev_fmgr_hook) (event, flinfo, private);
+
+		return;
+	}
+
+	if (!fcache)
+	{
+		fcache = MemoryContextAllocZero(flinfo->fn_mcxt,
+										sizeof(simple_fmgr_cache));
+
+		fcache->magic = SIMPLE_MAGIC;
+		fcache->is_hooked = is_hooked_oid(flinfo->fn_oid);
+
+		*private = PointerGetDatum(fcache);
+	}
+
+	if (fcache->is_hooked)
+	{
+		if (simple_trace_calls)
+			simple_trace_event(flinfo->fn_oid, event);
+
+		switch (event)
+		{
+			case FHET_START:
+				/* only outer call of recursive calls is accounted */
+				if (fcache->depth++ == 0)
+				{
+					if (track_memory)
+						memory_accounting_start(fcache, flinfo);
+
+					if (simple_track_queries)
+					{
+						INSTR_TIME_SET_CURRENT(fcache->start_time);
+						fcache->timed = true;
+					}
+				}
+				break;
+
+			case FHET_END:
+				if (--fcache->depth == 0)
+				{
+					if (fcache->call_cxt)
+						memory_accounting_end(fcache);
+
+					if (fcache->timed)
+					{
+						instr_time	duration;
+
+						INSTR_TIME_SET_CURRENT(duration);
+						INSTR_TIME_SUBTRACT(duration, fcache->start_time);
+
+						simple_query_stats_add(flinfo->fn_oid,
+											   INSTR_TIME_GET_MILLISEC(duration));
+						fcache->timed = false;
+					}
+				}
+				break;
+
+			case FHET_ABORT:
+				/*
+				 * The call context is released by cleaning after an error,
+				 * and it is not counted.
+				 */
+				if (--fcache->depth == 0)
+				{
+					if (fcache->call_cxt)
+					{
+						MemoryContextSwitchTo(fcache->caller_cxt);
+						fcache->call_cxt = NULL;
+						fcache->call_info = NULL;
+					}
+
+					/* aborted calls are not counted */
+					fcache->timed = false;
+				}
+				break;
+		}
+	}
+
+	if (prev_fmgr_hook)
+		(*prev_fmgr_hook) (event, flinfo, &fcache->prev_arg);
+}
+
+/*
+ * Returns memory statistics of hooked functions
+ */
+Datum
+simple_memory_stats(PG_FUNCTION_ARGS)
+{
+	ReturnSetInfo *rsinfo = (ReturnSetInfo *) fcinfo->resultinfo;
+
+	InitMaterializedSRF(fcinfo, 0);
+
+	if (memory_stats)
+	{
+		HASH_SEQ_STATUS hash_seq;
+		MemoryStatsEntry *entry;
+
+		hash_seq_init(&hash_seq, memory_stats);
+		while ((entry = hash_seq_search(&hash_seq)) != NULL)
+		{
+			Datum		values[7];
+			bool		nulls[7] = {0};
+
+			values[0] = ObjectIdGetDatum(entry->fn_oid);
+			values[1] = Int64GetDatum(entry->calls);
+			values[2] = Int64GetDatum(entry->total_bytes);
+			values[3] = Int64GetDatum(entry->peak_bytes);
+			values[4] = Int64GetDatum(entry->live_contexts);
+			values[5] = Int64GetDatum(entry->live_bytes);
+			values[6] = Int64GetDatum(entry->max_live_bytes);
+
+			tuplestore_putvalues(rsinfo->setResult, rsinfo->setDesc,
+								 values, nulls);
+		}
+	}
+
+	return (Datum) 0;
+}
+
+Datum
+simple_memory_stats_reset(PG_FUNCTION_ARGS)
+{
+	if (memory_stats)
+	{
+		hash_destroy(memory_stats);
+		memory_stats = NULL;
+	}
+
+	/* the callbacks of still living contexts should be ignored */
+	memory_stats_generation += 1;
+
+	PG_RETURN_VOID();
+}
+
+void
+simple_fmgr_hook_init(void)
+{
+	DefineCustomBoolVariable("simple.track_memory",
+							 "Collects memory statistics of int_func and text_func calls.",
+							 NULL,
+							 &track_memory,
+							 false,
+							 PGC_USERSET,
+							 0,
+							 NULL, NULL, NULL);
+
+	prev_needs_fmgr_hook = needs_fmgr_hook;
+	prev_fmgr_hook = fmgr_hook;
+
+	needs_fmgr_hook = simple_needs_fmgr_hook;
+	fmgr_hook = simple_fmgr_hook;
+}
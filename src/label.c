@@ -0,0 +1,652 @@
+/*-------------------------------------------------------------------------
+ *
+ * simple
+ *	  simple demo extension - dictionary encoded labels
+ *
+ * Author:	Pavel Stehule
+ * Postcardware licence @2024
+ *
+ * IDENTIFICATION
+ *	  label.c
+ *
+ * The results of text_func are usually from small set of values, that
+ * are repeated many times. The type simple_label stores only 4 bytes
+ * code of the value (passed by value, without varlena header). The
+ * values are stored in table simple_label_dict (one per database):
+ *
+ *     CREATE TABLE t(l simple_label);
+ *     INSERT INTO t SELECT text_func('Ahoj') FROM generate_series(1, 1000000);
+ *
+ * The input function searches the code of value, and when the value is
+ * not in dictionary yet, it is inserted (under owner of the dictionary
+ * like RI triggers do). So new labels cannot be created in read only
+ * transaction (or on standby). The codes and values are cached in
+ * backend memory. The rows of dictionary are never changed by the
+ * extension, but when they are updated or deleted, the statement
+ * trigger invalidates the relcache entry of dictionary, and the caches
+ * of all backends are reset. The cache is reset after abort of
+ * (sub)transaction that inserted some label too (the codes can be
+ * lost).
+ *
+ * The dictionary is dumped by pg_dump (it is extension's configuration
+ * table), and pg_upgrade keeps it with stored codes. The labels in user
+ * tables are dumped as text (the binary format is text too), and they
+ * can be restored before the dictionary (then the input function inserts
+ * them with new codes). The row trigger of dictionary skips restored
+ * rows with existing label, and assigns new code, when the code is used
+ * already (the codes of restored rows are not used by text data).
+ *
+ * Equality and hashing use only codes (one value has one code). The
+ * ordering is by value (bytewise like "C" collation), but equal codes
+ * are not compared, and the values are taken from cache.
+ *
+ *-------------------------------------------------------------------------
+ */
+
+#include "postgres.h"
+
+#include "access/htup_details.h"
+#include "access/xact.h"
+#include "catalog/pg_class.h"
+#include "catalog/pg_type.h"
+#include "commands/extension.h"
+#include "commands/trigger.h"
+#include "common/hashfn.h"
+#include "executor/spi.h"
+#include "libpq/pqformat.h"
+#include "miscadmin.h"
+#include "utils/builtins.h"
+#include "utils/hsearch.h"
+#include "utils/inval.h"
+#include "utils/lsyscache.h"
+#include "utils/memutils.h"
+#include "utils/sortsupport.h"
+#include "utils/syscache.h"
+
+#include "simple.h"
+
+PG_FUNCTION_INFO_V1(simple_label_in);
+PG_FUNCTION_INFO_V1(simple_label_out);
+PG_FUNCTION_INFO_V1(simple_label_recv);
+PG_FUNCTION_INFO_V1(simple_label_send);
+PG_FUNCTION_INFO_V1(simple_label_eq);
+PG_FUNCTION_INFO_V1(simple_label_ne);
+PG_FUNCTION_INFO_V1(simple_label_lt);
+PG_FUNCTION_INFO_V1(simple_label_le);
+PG_FUNCTION_INFO_V1(simple_label_gt);
+PG_FUNCTION_INFO_V1(simple_label_ge);
+PG_FUNCTION_INFO_V1(simple_label_cmp);
+PG_FUNCTION_INFO_V1(simple_label_sortsupport);
+PG_FUNCTION_INFO_V1(simple_label_hash);
+PG_FUNCTION_INFO_V1(simple_label_hash_extended);
+PG_FUNCTION_INFO_V1(simple_label_dict_invalidate);
+PG_FUNCTION_INFO_V1(simple_label_dict_insert);
+
+#define LABEL_DICT_NAME			"simple_label_dict"
+#define LABEL_DICT_SEQ_NAME		"simple_label_dict_code_seq"
+
+typedef struct LabelCodeEntry
+{
+	int32		code;			/* hash key */
+	char	   *label;
+} LabelCodeEntry;
+
+typedef struct LabelTextEntry
+{
+	char	   *label;			/* hash key */
+	int32		code;
+} LabelTextEntry;
+
+static MemoryContext label_cxt = NULL;
+static HTAB *label_codes = NULL;	/* code -> label */
+static HTAB *label_texts = NULL;	/* label -> code */
+
+static Oid	label_dict_relid = InvalidOid;
+static char *label_dict_name = NULL;	/* qualified name */
+
+/* true, when some label was inserted by current transaction */
+static bool label_inserted = false;
+
+static void
+label_cache_reset(void)
+{
+	if (label_cxt)
+		MemoryContextReset(label_cxt);
+
+	label_codes = NULL;
+	label_texts = NULL;
+	label_dict_relid = InvalidOid;
+	label_dict_name = NULL;
+}
+
+static void
+label_relcache_callback(Datum arg, Oid relid)
+{
+	if (relid == InvalidOid || relid == label_dict_relid)
+		label_cache_reset();
+}
+
+static void
+label_xact_callback(XactEvent event, void *arg)
+{
+	if (event == XACT_EVENT_ABORT || event == XACT_EVENT_PARALLEL_ABORT)
+	{
+		if (label_inserted)
+			label_cache_reset();
+
+		label_inserted = false;
+	}
+	else if (event == XACT_EVENT_COMMIT || event == XACT_EVENT_PARALLEL_COMMIT ||
+			 event == XACT_EVENT_PREPARE)
+		label_inserted = false;
+}
+
+static void
+label_subxact_callback(SubXactEvent event, SubTransactionId mySubid,
+					   SubTransactionId parentSubid, void *arg)
+{
+	if (event == SUBXACT_EVENT_ABORT_SUB && label_inserted)
+		label_cache_reset();
+}
+
+/*
+ * The key of label_texts is a pointer to string
+ */
+static uint32
+label_text_hash(const void *key, Size keysize)
+{
+	const char *label = *((const char *const *) key);
+
+	return hash_bytes((const unsigned char *) label, strlen(label));
+}
+
+static int
+label_text_match(const void *key1, const void *key2, Size keysize)
+{
+	return strcmp(*((const char *const *) key1),
+				  *((const char *const *) key2));
+}
+
+static void
+label_cache_init(void)
+{
+	HASHCTL		ctl;
+	Oid			extoid;
+	Oid			nspoid;
+
+	if (label_texts)
+		return;
+
+	if (!label_cxt)
+	{
+		label_cxt = AllocSetContextCreate(TopMemoryContext,
+										  "simple label cache",
+										  ALLOCSET_DEFAULT_SIZES);
+
+		CacheRegisterRelcacheCallback(label_relcache_callback, (Datum) 0);
+		RegisterXactCallback(label_xact_callback, NULL);
+		RegisterSubXactCallback(label_subxact_callback, NULL);
+	}
+
+	/* the extension is relocatable, so the schema is searched */
+	extoid = get_extension_oid("simple", false);
+	nspoid = get_extension_schema(extoid);
+
+	label_dict_relid = get_relname_relid(LABEL_DICT_NAME, nspoid);
+	if (!OidIsValid(label_dict_relid))
+		elog(ERROR, "table \"%s\" does not exist", LABEL_DICT_NAME);
+
+	label_dict_name = MemoryContextStrdup(label_cxt,
+										  quote_qualified_identifier(get_namespace_name(nspoid),
+																	 LABEL_DICT_NAME));
+
+	ctl.keysize = sizeof(int32);
+	ctl.entrysize = sizeof(LabelCodeEntry);
+	ctl.hcxt = label_cxt;
+
+	label_codes = hash_create("simple label codes",
+							  64,
+							  &ctl,
+							  HASH_ELEM | HASH_BLOBS | HASH_CONTEXT);
+
+	ctl.keysize = sizeof(char *);
+	ctl.entrysize = sizeof(LabelTextEntry);
+	ctl.hash = label_text_hash;
+	ctl.match = label_text_match;
+	ctl.hcxt = label_cxt;
+
+	label_texts = hash_create("simple label texts",
+							  64,
+							  &ctl,
+							  HASH_ELEM | HASH_FUNCTION | HASH_COMPARE | HASH_CONTEXT);
+}
+
+static const char *
+label_cache_add(int32 code, const char *label)
+{
+	LabelCodeEntry *centry;
+	LabelTextEntry *tentry;
+	char	   *str;
+	bool		found;
+
+	str = MemoryContextStrdup(label_cxt, label);
+
+	centry = hash_search(label_codes, &code, HASH_ENTER, &found);
+	centry->label = str;
+
+	tentry = hash_search(label_texts, &str, HASH_ENTER, &found);
+	tentry->label = str;
+	tentry->code = code;
+
+	return str;
+}
+
+/*
+ * Executes query with one parameter, and returns the value of first
+ * column. Returns false, when the query returns no row.
+ */
+static bool
+label_dict_query(const char *query, Oid argtype, Datum arg,
+				 bool read_only, Datum *result)
+{
+	bool		isnull = true;
+	int			res;
+
+	res = SPI_execute_with_args(query, 1, &argtype, &arg, NULL, read_only, 1);
+	if (res < 0)
+		elog(ERROR, "SPI_execute_with_args failed: %s", SPI_result_code_string(res));
+
+	if (SPI_processed > 0)
+		*result = SPI_getbinval(SPI_tuptable->vals[0], SPI_tuptable->tupdesc,
+								1, &isnull);
+
+	return !isnull;
+}
+
+static Oid
+label_dict_owner(Oid relid)
+{
+	HeapTuple	tuple;
+	Oid			owner;
+
+	tuple = SearchSysCache1(RELOID, ObjectIdGetDatum(relid));
+	if (!HeapTupleIsValid(tuple))
+		elog(ERROR, "cache lookup failed for relation %u", relid);
+
+	owner = ((Form_pg_class) GETSTRUCT(tuple))->relowner;
+
+	ReleaseSysCache(tuple);
+
+	return owner;
+}
+
+/*
+ * Returns the code of label. When the label is not in dictionary,
+ * then it is inserted.
+ */
+static int32
+label_get_code(const char *label)
+{
+	LabelTextEntry *entry;
+	Oid			dict_relid;
+	char	   *select_query;
+	Datum		arg;
+	Datum		code;
+	bool		found;
+
+	label_cache_init();
+
+	entry = hash_search(label_texts, &label, HASH_FIND, NULL);
+	if (entry)
+		return entry->code;
+
+	/* the cache can be reset by invalidation inside SPI */
+	dict_relid = label_dict_relid;
+	select_query = psprintf("SELECT code FROM %s WHERE label = $1",
+							label_dict_name);
+	arg = CStringGetTextDatum(label);
+
+	SPI_connect();
+
+	found = label_dict_query(select_query, TEXTOID, arg, true, &code);
+
+	if (!found)
+	{
+		char	   *insert_query;
+		Oid			save_userid;
+		int			save_sec_context;
+
+		insert_query = psprintf("INSERT INTO %s(label) VALUES($1) "
+								"ON CONFLICT (label) DO NOTHING "
+								"RETURNING code",
+								label_dict_name);
+
+		/* the users have not INSERT privilege on dictionary */
+		GetUserIdAndSecContext(&save_userid, &save_sec_context);
+		SetUserIdAndSecContext(label_dict_owner(dict_relid),
+							   save_sec_context | SECURITY_LOCAL_USERID_CHANGE |
+							   SECURITY_RESTRICTED_OPERATION);
+
+		/* concurrent insert of same label is possible */
+		found = label_dict_query(insert_query, TEXTOID, arg, false, &code);
+		if (!found)
+			found = label_dict_query(select_query, TEXTOID, arg, false, &code);
+
+		SetUserIdAndSecContext(save_userid, save_sec_context);
+
+		if (!found)
+			ereport(ERROR,
+					(errcode(ERRCODE_T_R_SERIALIZATION_FAILURE),
+					 errmsg("could not insert label \"%s\" to dictionary", label),
+					 errdetail("The label was inserted by concurrent transaction."),
+					 errhint("Retry the transaction.")));
+
+		label_inserted = true;
+	}
+
+	SPI_finish();
+
+	label_cache_init();
+	label_cache_add(DatumGetInt32(code), label);
+
+	return DatumGetInt32(code);
+}
+
+/*
+ * Returns the label of code. The returned string is in cache, and it
+ * must not be modified.
+ */
+static const char *
+label_get_text(int32 code)
+{
+	LabelCodeEntry *entry;
+	MemoryContext oldcxt = CurrentMemoryContext;
+	char	   *query;
+	Datum		label;
+	char	   *result;
+
+	label_cache_init();
+
+	entry = hash_search(label_codes, &code, HASH_FIND, NULL);
+	if (entry)
+		return entry->label;
+
+	query = psprintf("SELECT label FROM %s WHERE code = $1", label_dict_name);
+
+	SPI_connect();
+
+	if (!label_dict_query(query, INT4OID, Int32GetDatum(code), true, &label))
+		ereport(ERROR,
+				(errcode(ERRCODE_DATA_CORRUPTED),
+				 errmsg("label with code %d does not exist", code)));
+
+	/* the memory of SPI is released by SPI_finish */
+	result = MemoryContextStrdup(oldcxt, TextDatumGetCString(label));
+
+	SPI_finish();
+
+	label_cache_init();
+
+	return label_cache_add(code, result);
+}
+
+static int
+label_cmp(int32 code1, int32 code2)
+{
+	LabelCodeEntry *entry1;
+	LabelCodeEntry *entry2;
+	char	   *label1;
+	int			result;
+
+	if (code1 == code2)
+		return 0;
+
+	label_cache_init();
+
+	entry1 = hash_search(label_codes, &code1, HASH_FIND, NULL);
+	entry2 = hash_search(label_codes, &code2, HASH_FIND, NULL);
+
+	if (entry1 && entry2)
+		return strcmp(entry1->label, entry2->label);
+
+	/* the cache can be reset by loading of second label */
+	label1 = pstrdup(label_get_text(code1));
+	result = strcmp(label1, label_get_text(code2));
+	pfree(label1);
+
+	return result;
+}
+
+Datum
+simple_label_in(PG_FUNCTION_ARGS)
+{
+	char	   *str = PG_GETARG_CSTRING(0);
+
+	PG_RETURN_INT32(label_get_code(str));
+}
+
+Datum
+simple_label_out(PG_FUNCTION_ARGS)
+{
+	int32		code = PG_GETARG_INT32(0);
+
+	PG_RETURN_CSTRING(pstrdup(label_get_text(code)));
+}
+
+/*
+ * The binary format is text (the codes are different in
+ * other databases).
+ */
+Datum
+simple_label_recv(PG_FUNCTION_ARGS)
+{
+	StringInfo	buf = (StringInfo) PG_GETARG_POINTER(0);
+	char	   *str;
+	int			nbytes;
+
+	str = pq_getmsgtext(buf, buf->len - buf->cursor, &nbytes);
+
+	PG_RETURN_INT32(label_get_code(str));
+}
+
+Datum
+simple_label_send(PG_FUNCTION_ARGS)
+{
+	int32		code = PG_GETARG_INT32(0);
+	const char *label = label_get_text(code);
+	StringInfoData buf;
+
+	pq_begintypsend(&buf);
+	pq_sendtext(&buf, label, strlen(label));
+
+	PG_RETURN_BYTEA_P(pq_endtypsend(&buf));
+}
+
+Datum
+simple_label_eq(PG_FUNCTION_ARGS)
+{
+	PG_RETURN_BOOL(PG_GETARG_INT32(0) == PG_GETARG_INT32(1));
+}
+
+Datum
+simple_label_ne(PG_FUNCTION_ARGS)
+{
+	PG_RETURN_BOOL(PG_GETARG_INT32(0) != PG_GETARG_INT32(1));
+}
+
+Datum
+simple_label_lt(PG_FUNCTION_ARGS)
+{
+	PG_RETURN_BOOL(label_cmp(PG_GETARG_INT32(0), PG_GETARG_INT32(1)) < 0);
+}
+
+Datum
+simple_label_le(PG_FUNCTION_ARGS)
+{
+	PG_RETURN_BOOL(label_cmp(PG_GETARG_INT32(0), PG_GETARG_INT32(1)) <= 0);
+}
+
+Datum
+simple_label_gt(PG_FUNCTION_ARGS)
+{
+	PG_RETURN_BOOL(label_cmp(PG_GETARG_INT32(0), PG_GETARG_INT32(1)) > 0);
+}
+
+Datum
+simple_label_ge(PG_FUNCTION_ARGS)
+{
+	PG_RETURN_BOOL(label_cmp(PG_GETARG_INT32(0), PG_GETARG_INT32(1)) >= 0);
+}
+
+Datum
+simple_label_cmp(PG_FUNCTION_ARGS)
+{
+	PG_RETURN_INT32(label_cmp(PG_GETARG_INT32(0), PG_GETARG_INT32(1)));
+}
+
+static int
+label_fastcmp(Datum x, Datum y, SortSupport ssup)
+{
+	return label_cmp(DatumGetInt32(x), DatumGetInt32(y));
+}
+
+/*
+ * The sort uses comparator without fmgr overhead
+ */
+Datum
+simple_label_sortsupport(PG_FUNCTION_ARGS)
+{
+	SortSupport ssup = (SortSupport) PG_GETARG_POINTER(0);
+
+	ssup->comparator = label_fastcmp;
+
+	PG_RETURN_VOID();
+}
+
+Datum
+simple_label_hash(PG_FUNCTION_ARGS)
+{
+	return hash_uint32((uint32) PG_GETARG_INT32(0));
+}
+
+Datum
+simple_label_hash_extended(PG_FUNCTION_ARGS)
+{
+	return hash_uint32_extended((uint32) PG_GETARG_INT32(0), PG_GETARG_INT64(1));
+}
+
+/*
+ * Statement trigger of dictionary. Any change of dictionary (except
+ * insert) resets the caches of all backends.
+ */
+Datum
+simple_label_dict_invalidate(PG_FUNCTION_ARGS)
+{
+	TriggerData *trigdata = (TriggerData *) fcinfo->context;
+
+	if (!CALLED_AS_TRIGGER(fcinfo))
+		elog(ERROR, "simple_label_dict_invalidate: not called by trigger manager");
+
+	CacheInvalidateRelcache(trigdata->tg_relation);
+
+	return PointerGetDatum(NULL);
+}
+
+/*
+ * Row trigger of dictionary. The restored row with existing label is
+ * skipped, and the restored row with used code gets new code. The new
+ * code is necessary for new label too, when the sequence was set back
+ * by restore.
+ */
+Datum
+simple_label_dict_insert(PG_FUNCTION_ARGS)
+{
+	TriggerData *trigdata = (TriggerData *) fcinfo->context;
+	Relation	rel;
+	TupleDesc	tupdesc;
+	HeapTuple	tuple;
+	int			code_attno;
+	int			label_attno;
+	Datum		code;
+	Datum		label;
+	Datum		value;
+	bool		code_isnull;
+	bool		label_isnull;
+	bool		modified = false;
+	char	   *nspname;
+	char	   *label_query;
+	char	   *code_query;
+	char	   *nextval_query;
+
+	if (!CALLED_AS_TRIGGER(fcinfo))
+		elog(ERROR, "simple_label_dict_insert: not called by trigger manager");
+
+	if (!TRIGGER_FIRED_BEFORE(trigdata->tg_event) ||
+		!TRIGGER_FIRED_FOR_ROW(trigdata->tg_event) ||
+		!TRIGGER_FIRED_BY_INSERT(trigdata->tg_event))
+		elog(ERROR, "simple_label_dict_insert must be fired BEFORE INSERT for each row");
+
+	rel = trigdata->tg_relation;
+	tupdesc = RelationGetDescr(rel);
+	tuple = trigdata->tg_trigtuple;
+
+	code_attno = SPI_fnumber(tupdesc, "code");
+	label_attno = SPI_fnumber(tupdesc, "label");
+	if (code_attno <= 0 || label_attno <= 0)
+		elog(ERROR, "unexpected columns of label dictionary");
+
+	code = heap_getattr(tuple, code_attno, tupdesc, &code_isnull);
+	label = heap_getattr(tuple, label_attno, tupdesc, &label_isnull);
+
+	/* NOT NULL constraints raise an error */
+	if (code_isnull || label_isnull)
+		return PointerGetDatum(tuple);
+
+	nspname = get_namespace_name(RelationGetNamespace(rel));
+
+	label_query = psprintf("SELECT code FROM %s WHERE label = $1",
+						   quote_qualified_identifier(nspname,
+													  RelationGetRelationName(rel)));
+	code_query = psprintf("SELECT code FROM %s WHERE code = $1",
+						  quote_qualified_identifier(nspname,
+													 RelationGetRelationName(rel)));
+	nextval_query = psprintf("SELECT nextval(%s::regclass)::int",
+							 quote_literal_cstr(quote_qualified_identifier(nspname,
+																		   LABEL_DICT_SEQ_NAME)));
+
+	SPI_connect();
+
+	/* the label was inserted by input function before */
+	if (label_dict_query(label_query, TEXTOID, label, false, &value))
+	{
+		SPI_finish();
+
+		return PointerGetDatum(NULL);
+	}
+
+	while (label_dict_query(code_query, INT4OID, code, false, &value))
+	{
+		int			res;
+		bool		isnull;
+
+		res = SPI_execute(nextval_query, false, 1);
+		if (res != SPI_OK_SELECT || SPI_processed != 1)
+			elog(ERROR, "SPI_execute failed: %s", SPI_result_code_string(res));
+
+		code = SPI_getbinval(SPI_tuptable->vals[0], SPI_tuptable->tupdesc,
+							 1, &isnull);
+		modified = true;
+	}
+
+	SPI_finish();
+
+	if (modified)
+	{
+		bool		isnull = false;
+
+		tuple = heap_modify_tuple_by_cols(tuple, tupdesc,
+										  1, &code_attno, &code, &isnull);
+	}
+
+	return PointerGetDatum(tuple);
+}
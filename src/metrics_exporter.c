@@ -0,0 +1,283 @@
+/*-------------------------------------------------------------------------
+ *
+ * simple
+ *	  simple demo extension - export of metrics for Prometheus
+ *
+ * Author:	Pavel Stehule
+ * Postcardware licence @2024
+ *
+ * IDENTIFICATION
+ *	  metrics_exporter.c
+ *
+ * The background worker periodically (simple.metrics_interval) reads
+ * the statistics of int_func and text_func calls (query_stats.c), and
+ * writes them in Prometheus text exposition format to the file
+ * simple.metrics_file. This file can be read by textfile collector of
+ * node_exporter, so the monitoring doesn't need to execute any SQL.
+ *
+ *     shared_preload_libraries = 'simple'
+ *     simple.track_queries = on
+ *     simple.metrics_file = '/var/lib/node_exporter/textfile/simple.prom'
+ *
+ * The file is written to temporary file first, and then it is renamed,
+ * so the collector never reads incomplete file. Errors are only logged,
+ * and the worker tries to write the file again after next interval.
+ *
+ * The worker is not connected to any database, so the metrics are
+ * labeled by oid of database and by oid and name of function stored
+ * in shared table.
+ *
+ * The worker is started only when the library is loaded by
+ * shared_preload_libraries. When simple.metrics_file is empty, then
+ * the worker only sleeps. Same content returns function simple_metrics,
+ * so the format can be checked without the worker.
+ *
+ *-------------------------------------------------------------------------
+ */
+
+#include "postgres.h"
+
+#include <math.h>
+#include <unistd.h>
+
+#include "lib/stringinfo.h"
+#include "miscadmin.h"
+#include "postmaster/bgworker.h"
+#include "postmaster/interrupt.h"
+#include "storage/fd.h"
+#include "storage/ipc.h"
+#include "storage/latch.h"
+#include "tcop/tcopprot.h"
+#include "utils/builtins.h"
+#include "utils/guc.h"
+#include "utils/memutils.h"
+#include "utils/wait_event.h"
+
+#include "simple.h"
+
+PG_FUNCTION_INFO_V1(simple_metrics);
+
+PGDLLEXPORT void simple_metrics_exporter_main(Datum main_arg);
+
+static char *metrics_file = NULL;
+static int	metrics_interval = 15;
+
+/*
+ * Appends label value. The backslash, double quote and new line
+ * should be escaped.
+ */
+static void
+append_label_value(StringInfo buf, const char *str)
+{
+	for (const char *ptr = str; *ptr; ptr++)
+	{
+		if (*ptr == '\\' || *ptr == '"')
+			appendStringInfoChar(buf, '\\');
+
+		if (*ptr == '\n')
+			appendStringInfoString(buf, "\\n");
+		else
+			appendStringInfoChar(buf, *ptr);
+	}
+}
+
+static void
+append_metrics(StringInfo buf, SimpleFunctionMetrics *metrics, int nmetrics)
+{
+	appendStringInfoString(buf,
+						   "# HELP simple_function_duration_seconds Duration of int_func and text_func calls.\n"
+						   "# TYPE simple_function_duration_seconds histogram\n");
+
+	for (int i = 0; i < nmetrics; i++)
+	{
+		SimpleFunctionMetrics *m = &metrics[i];
+		StringInfoData labels;
+		int64		count = 0;
+
+		initStringInfo(&labels);
+		appendStringInfo(&labels, "datid=\"%u\",funcid=\"%u\",function=\"",
+						 m->dbid, m->fn_oid);
+		append_label_value(&labels, NameStr(m->fn_name));
+		appendStringInfoChar(&labels, '"');
+
+		/* the buckets of Prometheus histogram are cumulative */
+		for (int j = 0; j < SIMPLE_LATENCY_BUCKETS; j++)
+		{
+			count += m->buckets[j];
+
+			if (j < SIMPLE_LATENCY_BUCKETS - 1)
+				appendStringInfo(buf,
+								 "simple_function_duration_seconds_bucket{%s,le=\"%g\"} " INT64_FORMAT "\n",
+								 labels.data, ldexp(1.0, j) / 1000000.0, count);
+			else
+				appendStringInfo(buf,
+								 "simple_function_duration_seconds_bucket{%s,le=\"+Inf\"} " INT64_FORMAT "\n",
+								 labels.data, count);
+		}
+
+		appendStringInfo(buf,
+						 "simple_function_duration_seconds_sum{%s} %.9g\n",
+						 labels.data, m->total_time / 1000.0);
+		appendStringInfo(buf,
+						 "simple_function_duration_seconds_count{%s} " INT64_FORMAT "\n",
+						 labels.data, m->calls);
+	}
+}
+
+/*
+ * Writes metrics to temporary file, and renames it to metrics_file
+ */
+static void
+write_metrics_file(void)
+{
+	SimpleFunctionMetrics *metrics;
+	int			nmetrics;
+	StringInfoData buf;
+	char		tmppath[MAXPGPATH];
+	FILE	   *file;
+	bool		failed;
+
+	metrics = simple_query_stats_metrics(&nmetrics);
+
+	initStringInfo(&buf);
+	append_metrics(&buf, metrics, nmetrics);
+
+	snprintf(tmppath, MAXPGPATH, "%s.tmp", metrics_file);
+
+	file = AllocateFile(tmppath, PG_BINARY_W);
+	if (!file)
+	{
+		ereport(LOG,
+				(errcode_for_file_access(),
+				 errmsg("could not open file \"%s\" for writing: %m", tmppath)));
+		return;
+	}
+
+	failed = fwrite(buf.data, 1, buf.len, file) != (size_t) buf.len;
+
+	if (FreeFile(file) != 0 || failed)
+	{
+		ereport(LOG,
+				(errcode_for_file_access(),
+				 errmsg("could not write file \"%s\": %m", tmppath)));
+		unlink(tmppath);
+		return;
+	}
+
+	if (rename(tmppath, metrics_file) != 0)
+	{
+		ereport(LOG,
+				(errcode_for_file_access(),
+				 errmsg("could not rename file \"%s\" to \"%s\": %m",
+						tmppath, metrics_file)));
+		unlink(tmppath);
+	}
+}
+
+/*
+ * Returns metrics in same format like they are written to metrics_file
+ */
+Datum
+simple_metrics(PG_FUNCTION_ARGS)
+{
+	SimpleFunctionMetrics *metrics;
+	int			nmetrics;
+	StringInfoData buf;
+
+	simple_query_stats_attach();
+
+	metrics = simple_query_stats_metrics(&nmetrics);
+
+	initStringInfo(&buf);
+	append_metrics(&buf, metrics, nmetrics);
+
+	PG_RETURN_TEXT_P(cstring_to_text_with_len(buf.data, buf.len));
+}
+
+void
+simple_metrics_exporter_main(Datum main_arg)
+{
+	MemoryContext cxt;
+	uint32		wait_event_info;
+
+	pqsignal(SIGHUP, SignalHandlerForConfigReload);
+	pqsignal(SIGTERM, die);
+	BackgroundWorkerUnblockSignals();
+
+#if PG_VERSION_NUM >= 170000
+	wait_event_info = WaitEventExtensionNew("SimpleMetricsExporterMain");
+#else
+	wait_event_info = PG_WAIT_EXTENSION;
+#endif
+
+	cxt = AllocSetContextCreate(TopMemoryContext,
+								"simple metrics exporter",
+								ALLOCSET_DEFAULT_SIZES);
+
+	for (;;)
+	{
+		(void) WaitLatch(MyLatch,
+						 WL_LATCH_SET | WL_TIMEOUT | WL_EXIT_ON_PM_DEATH,
+						 metrics_interval * 1000L,
+						 wait_event_info);
+		ResetLatch(MyLatch);
+
+		CHECK_FOR_INTERRUPTS();
+
+		if (ConfigReloadPending)
+		{
+			ConfigReloadPending = false;
+			ProcessConfigFile(PGC_SIGHUP);
+		}
+
+		if (metrics_file && *metrics_file)
+		{
+			MemoryContext oldcxt = MemoryContextSwitchTo(cxt);
+
+			write_metrics_file();
+
+			MemoryContextSwitchTo(oldcxt);
+			MemoryContextReset(cxt);
+		}
+	}
+}
+
+void
+simple_metrics_exporter_init(void)
+{
+	BackgroundWorker worker;
+
+	DefineCustomStringVariable("simple.metrics_file",
+							   "Sets the file where the metrics for Prometheus are written.",
+							   "Empty string disables the export.",
+							   &metrics_file,
+							   "",
+							   PGC_SIGHUP,
+							   GUC_SUPERUSER_ONLY,
+							   NULL, NULL, NULL);
+
+	DefineCustomIntVariable("simple.metrics_interval",
+							"Sets the interval of writing the metrics file.",
+							NULL,
+							&metrics_interval,
+							15,
+							1,
+							3600,
+							PGC_SIGHUP,
+							GUC_UNIT_S,
+							NULL, NULL, NULL);
+
+	if (!process_shared_preload_libraries_in_progress)
+		return;
+
+	memset(&worker, 0, sizeof(worker));
+	worker.bgw_flags = BGWORKER_SHMEM_ACCESS;
+	worker.bgw_start_time = BgWorkerStart_ConsistentState;
+	worker.bgw_restart_time = 60;
+	snprintf(worker.bgw_library_name, BGW_MAXLEN, "simple");
+	snprintf(worker.bgw_function_name, BGW_MAXLEN, "simple_metrics_exporter_main");
+	snprintf(worker.bgw_name, BGW_MAXLEN, "simple metrics exporter");
+	snprintf(worker.bgw_type, BGW_MAXLEN, "simple metrics exporter");
+
+	RegisterBackgroundWorker(&worker);
+}
@@ -0,0 +1,398 @@
+/*-------------------------------------------------------------------------
+ *
+ * simple
+ *	  simple demo extension - compact binary format of option lists
+ *
+ * Author:	Pavel Stehule
+ * Postcardware licence @2024
+ *
+ * IDENTIFICATION
+ *	  nodelist.c
+ *
+ * The lesson simple_9.c shows List of String, Integer, Boolean and DefElem
+ * nodes. The text format of nodes (nodeToString, stringToNode) is generic,
+ * but it is verbose and the parsing is slow. For passing of option lists
+ * between sessions (in tables) there is an simple binary format:
+ *
+ *     'L' int32 n, n nodes        List
+ *     'S' int32 len, bytes        String
+ *     'I' int32                   Integer
+ *     'B' byte                    Boolean
+ *     'D' namespace, name,        DefElem, namespace is 'S' or '-',
+ *         int32 action, arg       arg is node or '-'
+ *     '-'                         NULL
+ *
+ * Integers are in network byte order (pqformat.h functions are used).
+ *
+ *-------------------------------------------------------------------------
+ */
+
+#include "postgres.h"
+#include "varatt.h"
+
+#include "funcapi.h"
+#include "libpq/pqformat.h"
+#include "miscadmin.h"
+#include "nodes/makefuncs.h"
+#include "nodes/value.h"
+#include "portability/instr_time.h"
+#include "utils/builtins.h"
+
+#include "simple.h"
+
+PG_FUNCTION_INFO_V1(simple_nodes_encode);
+PG_FUNCTION_INFO_V1(simple_nodes_decode);
+PG_FUNCTION_INFO_V1(simple_nodes_bench);
+
+#define NODELIST_VERSION		1
+
+static void
+encode_string(StringInfo buf, const char *str)
+{
+	int			len = strlen(str);
+
+	pq_sendbyte(buf, 'S');
+	pq_sendint32(buf, len);
+	pq_sendbytes(buf, str, len);
+}
+
+static void
+encode_node(StringInfo buf, Node *node)
+{
+	check_stack_depth();
+
+	if (node == NULL)
+	{
+		pq_sendbyte(buf, '-');
+		return;
+	}
+
+	switch (nodeTag(node))
+	{
+		case T_List:
+			{
+				List	   *list = (List *) node;
+				ListCell   *lc;
+
+				pq_sendbyte(buf, 'L');
+				pq_sendint32(buf, list_length(list));
+
+				foreach(lc, list)
+					encode_node(buf, (Node *) lfirst(lc));
+			}
+			break;
+
+		case T_String:
+			encode_string(buf, strVal(node));
+			break;
+
+		case T_Integer:
+			pq_sendbyte(buf, 'I');
+			pq_sendint32(buf, intVal(node));
+			break;
+
+		case T_Boolean:
+			pq_sendbyte(buf, 'B');
+			pq_sendbyte(buf, boolVal(node) ? 1 : 0);
+			break;
+
+		case T_DefElem:
+			{
+				DefElem    *defel = (DefElem *) node;
+
+				pq_sendbyte(buf, 'D');
+
+				if (defel->defnamespace)
+					encode_string(buf, defel->defnamespace);
+				else
+					pq_sendbyte(buf, '-');
+
+				encode_string(buf, defel->defname);
+				pq_sendint32(buf, (int32) defel->defaction);
+				encode_node(buf, defel->arg);
+			}
+			break;
+
+		default:
+			ereport(ERROR,
+					(errcode(ERRCODE_FEATURE_NOT_SUPPORTED),
+					 errmsg("unsupported node type"),
+					 errdetail("Only List, String, Integer, Boolean and DefElem nodes are supported.")));
+	}
+}
+
+static char *
+decode_string(StringInfo buf)
+{
+	int			len;
+	char	   *str;
+
+	if (pq_getmsgbyte(buf) != 'S')
+		ereport(ERROR,
+				(errcode(ERRCODE_INVALID_BINARY_REPRESENTATION),
+				 errmsg("invalid binary format of node list"),
+				 errdetail("String was expected.")));
+
+	len = pq_getmsgint(buf, 4);
+	if (len < 0)
+		ereport(ERROR,
+				(errcode(ERRCODE_INVALID_BINARY_REPRESENTATION),
+				 errmsg("invalid binary format of node list"),
+				 errdetail("Invalid length of string.")));
+
+	str = palloc(len + 1);
+	pq_copymsgbytes(buf, str, len);
+	str[len] = '\0';
+
+	return str;
+}
+
+static Node *
+decode_node(StringInfo buf)
+{
+	int			tag;
+
+	check_stack_depth();
+
+	/* String tag is checked by decode_string */
+	if (buf->cursor < buf->len && buf->data[buf->cursor] == 'S')
+		return (Node *) makeString(decode_string(buf));
+
+	tag = pq_getmsgbyte(buf);
+
+	switch (tag)
+	{
+		case '-':
+			return NULL;
+
+		case 'L':
+			{
+				List	   *list = NIL;
+				int			n = pq_getmsgint(buf, 4);
+
+				/* any node needs at least one byte */
+				if (n < 0 || n > buf->len - buf->cursor)
+					ereport(ERROR,
+							(errcode(ERRCODE_INVALID_BINARY_REPRESENTATION),
+							 errmsg("invalid binary format of node list"),
+							 errdetail("Invalid length of list.")));
+
+				for (int i = 0; i < n; i++)
+					list = lappend(list, decode_node(buf));
+
+				return (Node *) list;
+			}
+
+		case 'I':
+			return (Node *) makeInteger(pq_getmsgint(buf, 4));
+
+		case 'B':
+			return (Node *) makeBoolean(pq_getmsgbyte(buf) != 0);
+
+		case 'D':
+			{
+				DefElem    *defel = makeNode(DefElem);
+
+				if (buf->cursor < buf->len && buf->data[buf->cursor] == '-')
+				{
+					buf->cursor++;
+					defel->defnamespace = NULL;
+				}
+				else
+					defel->defnamespace = decode_string(buf);
+
+				defel->defname = decode_string(buf);
+				defel->defaction = (DefElemAction) pq_getmsgint(buf, 4);
+				defel->arg = decode_node(buf);
+				defel->location = -1;
+
+				if (defel->defaction < DEFELEM_UNSPEC ||
+					defel->defaction > DEFELEM_DROP)
+					ereport(ERROR,
+							(errcode(ERRCODE_INVALID_BINARY_REPRESENTATION),
+							 errmsg("invalid binary format of node list"),
+							 errdetail("Invalid action of DefElem.")));
+
+				return (Node *) defel;
+			}
+
+		default:
+			ereport(ERROR,
+					(errcode(ERRCODE_INVALID_BINARY_REPRESENTATION),
+					 errmsg("invalid binary format of node list"),
+					 errdetail("Unknown tag \"%c\".", tag)));
+	}
+
+	return NULL;				/* keep compiler quiet */
+}
+
+static bytea *
+encode_nodes(Node *node)
+{
+	StringInfoData buf;
+
+	pq_begintypsend(&buf);
+	pq_sendbyte(&buf, NODELIST_VERSION);
+	encode_node(&buf, node);
+
+	return pq_endtypsend(&buf);
+}
+
+static Node *
+decode_nodes(bytea *data)
+{
+	StringInfoData buf;
+	Node	   *node;
+
+	/* read only StringInfo over bytea data */
+	buf.data = VARDATA_ANY(data);
+	buf.len = VARSIZE_ANY_EXHDR(data);
+	buf.maxlen = 0;
+	buf.cursor = 0;
+
+	if (pq_getmsgbyte(&buf) != NODELIST_VERSION)
+		ereport(ERROR,
+				(errcode(ERRCODE_INVALID_BINARY_REPRESENTATION),
+				 errmsg("unsupported version of binary format of node list")));
+
+	node = decode_node(&buf);
+
+	if (buf.cursor != buf.len)
+		ereport(ERROR,
+				(errcode(ERRCODE_INVALID_BINARY_REPRESENTATION),
+				 errmsg("invalid binary format of node list"),
+				 errdetail("Unexpected data after end of list.")));
+
+	return node;
+}
+
+/*
+ * Converts text format of nodes to binary format. stringToNode is
+ * not safe for untrusted input, so this function is not executable
+ * by public.
+ */
+Datum
+simple_nodes_encode(PG_FUNCTION_ARGS)
+{
+	char	   *str = text_to_cstring(PG_GETARG_TEXT_PP(0));
+
+	PG_RETURN_BYTEA_P(encode_nodes((Node *) stringToNode(str)));
+}
+
+Datum
+simple_nodes_decode(PG_FUNCTION_ARGS)
+{
+	Node	   *node = decode_nodes(PG_GETARG_BYTEA_PP(0));
+
+	PG_RETURN_TEXT_P(cstring_to_text(nodeToString(node)));
+}
+
+/*
+ * Option list like in simple_9.c with n DefElem nodes
+ */
+static List *
+make_bench_list(int n)
+{
+	List	   *list = NIL;
+
+	for (int i = 0; i < n; i++)
+	{
+		Node	   *arg;
+
+		switch (i % 3)
+		{
+			case 0:
+				arg = (Node *) makeString(psprintf("value %d", i));
+				break;
+			case 1:
+				arg = (Node *) makeInteger(i);
+				break;
+			default:
+				arg = (Node *) makeBoolean(i % 2 == 0);
+				break;
+		}
+
+		list = lappend(list, makeDefElem(psprintf("option %d", i), arg, -1));
+	}
+
+	return list;
+}
+
+/*
+ * Compares text and binary format of list with n options. Returns
+ * size of serialized data and time of serialization and deserialization
+ * in ms.
+ */
+Datum
+simple_nodes_bench(PG_FUNCTION_ARGS)
+{
+	ReturnSetInfo *rsinfo = (ReturnSetInfo *) fcinfo->resultinfo;
+	int			n = PG_GETARG_INT32(0);
+	List	   *list;
+	instr_time	start;
+	instr_time	duration;
+	double		encode_time;
+	double		decode_time;
+	char	   *str;
+	bytea	   *data;
+	Node	   *node;
+	Datum		values[4];
+	bool		nulls[4] = {0};
+
+	if (n < 0)
+		ereport(ERROR,
+				(errcode(ERRCODE_INVALID_PARAMETER_VALUE),
+				 errmsg("number of options should be positive")));
+
+	InitMaterializedSRF(fcinfo, 0);
+
+	list = make_bench_list(n);
+
+	/* text format */
+	INSTR_TIME_SET_CURRENT(start);
+	str = nodeToString(list);
+	INSTR_TIME_SET_CURRENT(duration);
+	INSTR_TIME_SUBTRACT(duration, start);
+	encode_time = INSTR_TIME_GET_MILLISEC(duration);
+
+	INSTR_TIME_SET_CURRENT(start);
+	node = stringToNode(str);
+	INSTR_TIME_SET_CURRENT(duration);
+	INSTR_TIME_SUBTRACT(duration, start);
+	decode_time = INSTR_TIME_GET_MILLISEC(duration);
+
+	if (!equal(list, node))
+		elog(ERROR, "text format of node list is broken");
+
+	values[0] = CStringGetTextDatum("text");
+	values[1] = Int64GetDatum(strlen(str));
+	values[2] = Float8GetDatum(encode_time);
+	values[3] = Float8GetDatum(decode_time);
+
+	tuplestore_putvalues(rsinfo->setResult, rsinfo->setDesc, values, nulls);
+
+	/* binary format */
+	INSTR_TIME_SET_CURRENT(start);
+	data = encode_nodes((Node *) list);
+	INSTR_TIME_SET_CURRENT(duration);
+	INSTR_TIME_SUBTRACT(duration, start);
+	encode_time = INSTR_TIME_GET_MILLISEC(duration);
+
+	INSTR_TIME_SET_CURRENT(start);
+	node = decode_nodes(data);
+	INSTR_TIME_SET_CURRENT(duration);
+	INSTR_TIME_SUBTRACT(duration, start);
+	decode_time = INSTR_TIME_GET_MILLISEC(duration);
+
+	if (!equal(list, node))
+		elog(ERROR, "binary format of node list is broken");
+
+	values[0] = CStringGetTextDatum("binary");
+	values[1] = Int64GetDatum(VARSIZE(data) - VARHDRSZ);
+	values[2] = Float8GetDatum(encode_time);
+	values[3] = Float8GetDatum(decode_time);
+
+	tuplestore_putvalues(rsinfo->setResult, rsinfo->setDesc, values, nulls);
+
+	return (Datum) 0;
+}
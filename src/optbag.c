@@ -0,0 +1,615 @@
+/*-------------------------------------------------------------------------
+ *
+ * simple
+ *	  simple demo extension - key/value option bag with expanded form
+ *
+ * Author:	Pavel Stehule
+ * Postcardware licence @2024
+ *
+ * IDENTIFICATION
+ *	  optbag.c
+ *
+ * The lesson simple_9.c builds a List of nodes and flattens it to text
+ * on every call. The type optbag holds similar data (pairs of key and
+ * value) and it has two forms:
+ *
+ *   flat form     - varlena used for storing in tables (and for toasting),
+ *                   it is sequence of key\0value\0 strings
+ *
+ *   expanded form - (see utils/expandeddatum.h) in memory structure with
+ *                   arrays of keys and values, and hash index of keys
+ *
+ * optbag_set returns the expanded form, and when it gets read/write
+ * pointer to expanded optbag (PL/pgSQL variable), then it modifies it
+ * in place without copy. So updating of PL/pgSQL variable in loop
+ * is O(1) instead O(n) (the value is flattened only when it is stored).
+ * PL/pgSQL 18 asks the support function (SupportRequestModifyInPlace)
+ * if the variable can be passed as read/write pointer. On older
+ * releases PL/pgSQL passes read only pointer, and then the expanded
+ * form is copied (but without parsing of flat form).
+ *
+ * The text format is key=value[, ...]. Keys and values are double
+ * quoted, when it is necessary.
+ *
+ *-------------------------------------------------------------------------
+ */
+
+#include "postgres.h"
+#include "varatt.h"
+
+#include "common/hashfn.h"
+#include "nodes/nodeFuncs.h"
+#include "nodes/supportnodes.h"
+#include "parser/scansup.h"
+#include "utils/builtins.h"
+#include "utils/expandeddatum.h"
+#include "utils/hsearch.h"
+#include "utils/memutils.h"
+
+#include "simple.h"
+
+PG_FUNCTION_INFO_V1(optbag_in);
+PG_FUNCTION_INFO_V1(optbag_out);
+PG_FUNCTION_INFO_V1(optbag_set);
+PG_FUNCTION_INFO_V1(optbag_get);
+PG_FUNCTION_INFO_V1(optbag_count);
+PG_FUNCTION_INFO_V1(optbag_support);
+
+typedef struct OptBag
+{
+	int32		vl_len_;		/* varlena header (do not touch directly!) */
+	int32		nentries;
+	char		data[FLEXIBLE_ARRAY_MEMBER];	/* key\0value\0 ... */
+} OptBag;
+
+#define OPTBAG_HDRSZ		offsetof(OptBag, data)
+
+#define EOB_MAGIC			2024101114
+
+typedef struct ExpandedOptBag
+{
+	ExpandedObjectHeader hdr;
+	int			eob_magic;
+
+	int			nentries;
+	int			maxentries;
+	char	  **keys;
+	char	  **values;
+	HTAB	   *index;			/* key -> position in arrays */
+
+	Size		datasize;		/* size of data of flat form */
+} ExpandedOptBag;
+
+typedef struct OptBagIndexEntry
+{
+	char	   *key;			/* hash key - pointer to string in keys */
+	int			pos;
+} OptBagIndexEntry;
+
+static Size EOB_get_flat_size(ExpandedObjectHeader *eohptr);
+static void EOB_flatten_into(ExpandedObjectHeader *eohptr,
+							 void *result, Size allocated_size);
+
+static const ExpandedObjectMethods EOB_methods =
+{
+	EOB_get_flat_size,
+	EOB_flatten_into
+};
+
+/*
+ * The hash keys are pointers to strings
+ */
+static uint32
+optbag_key_hash(const void *key, Size keysize)
+{
+	const char *str = *(const char *const *) key;
+
+	return hash_bytes((const unsigned char *) str, strlen(str));
+}
+
+static int
+optbag_key_match(const void *key1, const void *key2, Size keysize)
+{
+	return strcmp(*(const char *const *) key1, *(const char *const *) key2);
+}
+
+static ExpandedOptBag *
+make_expanded_optbag(MemoryContext parentcontext, int maxentries)
+{
+	MemoryContext objcxt;
+	ExpandedOptBag *eob;
+	HASHCTL		ctl;
+
+	objcxt = AllocSetContextCreate(parentcontext,
+								   "expanded optbag",
+								   ALLOCSET_START_SMALL_SIZES);
+
+	eob = MemoryContextAlloc(objcxt, sizeof(ExpandedOptBag));
+
+	EOH_init_header(&eob->hdr, &EOB_methods, objcxt);
+	eob->eob_magic = EOB_MAGIC;
+
+	eob->nentries = 0;
+	eob->maxentries = Max(maxentries, 8);
+	eob->keys = MemoryContextAlloc(objcxt, sizeof(char *) * eob->maxentries);
+	eob->values = MemoryContextAlloc(objcxt, sizeof(char *) * eob->maxentries);
+	eob->datasize = 0;
+
+	ctl.keysize = sizeof(char *);
+	ctl.entrysize = sizeof(OptBagIndexEntry);
+	ctl.hash = optbag_key_hash;
+	ctl.match = optbag_key_match;
+	ctl.hcxt = objcxt;
+
+	eob->index = hash_create("optbag index",
+							 eob->maxentries,
+							 &ctl,
+							 HASH_ELEM | HASH_FUNCTION | HASH_COMPARE | HASH_CONTEXT);
+
+	return eob;
+}
+
+/*
+ * Sets value of key. The strings are copied.
+ */
+static void
+eob_set(ExpandedOptBag *eob, const char *key, const char *value)
+{
+	MemoryContext objcxt = eob->hdr.eoh_context;
+	OptBagIndexEntry *entry;
+	bool		found;
+
+	entry = hash_search(eob->index, &key, HASH_FIND, NULL);
+	if (entry)
+	{
+		char	   *oldvalue = eob->values[entry->pos];
+
+		eob->datasize -= strlen(oldvalue);
+		eob->values[entry->pos] = MemoryContextStrdup(objcxt, value);
+		eob->datasize += strlen(value);
+
+		pfree(oldvalue);
+
+		return;
+	}
+
+	if (eob->nentries >= eob->maxentries)
+	{
+		eob->maxentries *= 2;
+		eob->keys = repalloc(eob->keys, sizeof(char *) * eob->maxentries);
+		eob->values = repalloc(eob->values, sizeof(char *) * eob->maxentries);
+	}
+
+	eob->keys[eob->nentries] = MemoryContextStrdup(objcxt, key);
+	eob->values[eob->nentries] = MemoryContextStrdup(objcxt, value);
+
+	entry = hash_search(eob->index, &eob->keys[eob->nentries], HASH_ENTER, &found);
+	Assert(!found);
+	entry->pos = eob->nentries;
+
+	eob->datasize += strlen(key) + strlen(value) + 2;
+	eob->nentries += 1;
+}
+
+static const char *
+eob_get(ExpandedOptBag *eob, const char *key)
+{
+	OptBagIndexEntry *entry;
+
+	entry = hash_search(eob->index, &key, HASH_FIND, NULL);
+
+	return entry ? eob->values[entry->pos] : NULL;
+}
+
+static ExpandedOptBag *
+DatumGetExpandedOptBagPtr(Datum d)
+{
+	ExpandedOptBag *eob = (ExpandedOptBag *) DatumGetEOHP(d);
+
+	if (eob->eob_magic != EOB_MAGIC)
+		elog(ERROR, "expanded object is not optbag");
+
+	return eob;
+}
+
+/*
+ * Returns expanded copy of optbag (the source can be flat or expanded).
+ */
+static ExpandedOptBag *
+expand_optbag(Datum d, MemoryContext parentcontext)
+{
+	ExpandedOptBag *eob;
+
+	if (VARATT_IS_EXTERNAL_EXPANDED(DatumGetPointer(d)))
+	{
+		ExpandedOptBag *src = DatumGetExpandedOptBagPtr(d);
+
+		eob = make_expanded_optbag(parentcontext, src->nentries);
+
+		for (int i = 0; i < src->nentries; i++)
+			eob_set(eob, src->keys[i], src->values[i]);
+	}
+	else
+	{
+		OptBag	   *bag = (OptBag *) PG_DETOAST_DATUM(d);
+		const char *ptr = bag->data;
+
+		eob = make_expanded_optbag(parentcontext, bag->nentries);
+
+		for (int i = 0; i < bag->nentries; i++)
+		{
+			const char *key = ptr;
+			const char *value = key + strlen(key) + 1;
+
+			eob_set(eob, key, value);
+			ptr = value + strlen(value) + 1;
+		}
+	}
+
+	return eob;
+}
+
+static Size
+EOB_get_flat_size(ExpandedObjectHeader *eohptr)
+{
+	ExpandedOptBag *eob = (ExpandedOptBag *) eohptr;
+
+	Assert(eob->eob_magic == EOB_MAGIC);
+
+	return OPTBAG_HDRSZ + eob->datasize;
+}
+
+static void
+EOB_flatten_into(ExpandedObjectHeader *eohptr,
+				 void *result, Size allocated_size)
+{
+	ExpandedOptBag *eob = (ExpandedOptBag *) eohptr;
+	OptBag	   *bag = (OptBag *) result;
+	char	   *ptr = bag->data;
+
+	Assert(eob->eob_magic == EOB_MAGIC);
+	Assert(allocated_size == OPTBAG_HDRSZ + eob->datasize);
+
+	SET_VARSIZE(bag, allocated_size);
+	bag->nentries = eob->nentries;
+
+	for (int i = 0; i < eob->nentries; i++)
+	{
+		int			keylen = strlen(eob->keys[i]) + 1;
+		int			valuelen = strlen(eob->values[i]) + 1;
+
+		memcpy(ptr, eob->keys[i], keylen);
+		ptr += keylen;
+		memcpy(ptr, eob->values[i], valuelen);
+		ptr += valuelen;
+	}
+}
+
+/*
+ * Reads key or value. Returns palloced string.
+ */
+static char *
+read_token(char **ptr, const char *str)
+{
+	StringInfoData token;
+	char	   *p = *ptr;
+
+	initStringInfo(&token);
+
+	if (*p == '"')
+	{
+		p++;
+		while (*p != '"')
+		{
+			if (*p == '\0')
+				ereport(ERROR,
+						(errcode(ERRCODE_INVALID_TEXT_REPRESENTATION),
+						 errmsg("invalid input syntax for type optbag: \"%s\"", str),
+						 errdetail("Unexpected end of input.")));
+
+			if (*p == '\\' && p[1] != '\0')
+				p++;
+
+			appendStringInfoChar(&token, *p++);
+		}
+		p++;
+	}
+	else
+	{
+		while (*p != '\0' && *p != '=' && *p != ',' && !scanner_isspace(*p))
+			appendStringInfoChar(&token, *p++);
+
+		if (token.len == 0)
+			ereport(ERROR,
+					(errcode(ERRCODE_INVALID_TEXT_REPRESENTATION),
+					 errmsg("invalid input syntax for type optbag: \"%s\"", str)));
+	}
+
+	*ptr = p;
+
+	return token.data;
+}
+
+static void
+skip_spaces(char **ptr)
+{
+	while (scanner_isspace(**ptr))
+		(*ptr)++;
+}
+
+Datum
+optbag_in(PG_FUNCTION_ARGS)
+{
+	char	   *str = PG_GETARG_CSTRING(0);
+	char	   *p = str;
+	ExpandedOptBag *eob;
+	OptBag	   *bag;
+	Size		size;
+
+	eob = make_expanded_optbag(CurrentMemoryContext, 0);
+
+	skip_spaces(&p);
+
+	while (*p != '\0')
+	{
+		char	   *key;
+		char	   *value;
+
+		key = read_token(&p, str);
+		skip_spaces(&p);
+
+		if (*p != '=')
+			ereport(ERROR,
+					(errcode(ERRCODE_INVALID_TEXT_REPRESENTATION),
+					 errmsg("invalid input syntax for type optbag: \"%s\"", str),
+					 errdetail("Expected \"=\" after key \"%s\".", key)));
+		p++;
+		skip_spaces(&p);
+
+		value = read_token(&p, str);
+		skip_spaces(&p);
+
+		eob_set(eob, key, value);
+
+		if (*p == ',')
+		{
+			p++;
+			skip_spaces(&p);
+
+			if (*p == '\0')
+				ereport(ERROR,
+						(errcode(ERRCODE_INVALID_TEXT_REPRESENTATION),
+						 errmsg("invalid input syntax for type optbag: \"%s\"", str),
+						 errdetail("Unexpected end of input.")));
+		}
+		else if (*p != '\0')
+			ereport(ERROR,
+					(errcode(ERRCODE_INVALID_TEXT_REPRESENTATION),
+					 errmsg("invalid input syntax for type optbag: \"%s\"", str),
+					 errdetail("Expected \",\" or end of input.")));
+	}
+
+	/* the input function should to return flat value */
+	size = EOH_get_flat_size(&eob->hdr);
+	bag = palloc(size);
+	EOH_flatten_into(&eob->hdr, bag, size);
+
+	DeleteExpandedObject(EOHPGetRWDatum(&eob->hdr));
+
+	PG_RETURN_POINTER(bag);
+}
+
+static void
+append_token(StringInfo str, const char *token)
+{
+	bool		needs_quotes = *token == '\0';
+
+	for (const char *p = token; *p; p++)
+	{
+		if (*p == '=' || *p == ',' || *p == '"' || *p == '\\' ||
+			scanner_isspace(*p))
+		{
+			needs_quotes = true;
+			break;
+		}
+	}
+
+	if (!needs_quotes)
+	{
+		appendStringInfoString(str, token);
+		return;
+	}
+
+	appendStringInfoChar(str, '"');
+
+	for (const char *p = token; *p; p++)
+	{
+		if (*p == '"' || *p == '\\')
+			appendStringInfoChar(str, '\\');
+		appendStringInfoChar(str, *p);
+	}
+
+	appendStringInfoChar(str, '"');
+}
+
+Datum
+optbag_out(PG_FUNCTION_ARGS)
+{
+	Datum		d = PG_GETARG_DATUM(0);
+	StringInfoData str;
+
+	initStringInfo(&str);
+
+	if (VARATT_IS_EXTERNAL_EXPANDED(DatumGetPointer(d)))
+	{
+		ExpandedOptBag *eob = DatumGetExpandedOptBagPtr(d);
+
+		for (int i = 0; i < eob->nentries; i++)
+		{
+			if (i > 0)
+				appendStringInfoString(&str, ", ");
+
+			append_token(&str, eob->keys[i]);
+			appendStringInfoChar(&str, '=');
+			append_token(&str, eob->values[i]);
+		}
+	}
+	else
+	{
+		OptBag	   *bag = (OptBag *) PG_DETOAST_DATUM(d);
+		const char *ptr = bag->data;
+
+		for (int i = 0; i < bag->nentries; i++)
+		{
+			if (i > 0)
+				appendStringInfoString(&str, ", ");
+
+			append_token(&str, ptr);
+			ptr += strlen(ptr) + 1;
+			appendStringInfoChar(&str, '=');
+			append_token(&str, ptr);
+			ptr += strlen(ptr) + 1;
+		}
+	}
+
+	PG_RETURN_CSTRING(str.data);
+}
+
+/*
+ * Sets value of key. NULL optbag is same like empty optbag. When the
+ * argument is read/write pointer to expanded optbag, then it is
+ * modified in place.
+ */
+Datum
+optbag_set(PG_FUNCTION_ARGS)
+{
+	ExpandedOptBag *eob;
+	char	   *key;
+	char	   *value;
+
+	if (PG_ARGISNULL(1))
+		ereport(ERROR,
+				(errcode(ERRCODE_NULL_VALUE_NOT_ALLOWED),
+				 errmsg("key of optbag cannot be null")));
+
+	if (PG_ARGISNULL(2))
+		ereport(ERROR,
+				(errcode(ERRCODE_NULL_VALUE_NOT_ALLOWED),
+				 errmsg("value of optbag cannot be null")));
+
+	if (PG_ARGISNULL(0))
+		eob = make_expanded_optbag(CurrentMemoryContext, 0);
+	else if (VARATT_IS_EXTERNAL_EXPANDED_RW(DatumGetPointer(PG_GETARG_DATUM(0))))
+		eob = DatumGetExpandedOptBagPtr(PG_GETARG_DATUM(0));
+	else
+		eob = expand_optbag(PG_GETARG_DATUM(0), CurrentMemoryContext);
+
+	key = text_to_cstring(PG_GETARG_TEXT_PP(1));
+	value = text_to_cstring(PG_GETARG_TEXT_PP(2));
+
+	eob_set(eob, key, value);
+
+	pfree(key);
+	pfree(value);
+
+	PG_RETURN_DATUM(EOHPGetRWDatum(&eob->hdr));
+}
+
+Datum
+optbag_get(PG_FUNCTION_ARGS)
+{
+	Datum		d = PG_GETARG_DATUM(0);
+	char	   *key = text_to_cstring(PG_GETARG_TEXT_PP(1));
+	const char *value = NULL;
+
+	if (VARATT_IS_EXTERNAL_EXPANDED(DatumGetPointer(d)))
+		value = eob_get(DatumGetExpandedOptBagPtr(d), key);
+	else
+	{
+		OptBag	   *bag = (OptBag *) PG_DETOAST_DATUM(d);
+		const char *ptr = bag->data;
+
+		for (int i = 0; i < bag->nentries; i++)
+		{
+			const char *v = ptr + strlen(ptr) + 1;
+
+			if (strcmp(ptr, key) == 0)
+			{
+				value = v;
+				break;
+			}
+
+			ptr = v + strlen(v) + 1;
+		}
+	}
+
+	if (!value)
+		PG_RETURN_NULL();
+
+	PG_RETURN_TEXT_P(cstring_to_text(value));
+}
+
+Datum
+optbag_count(PG_FUNCTION_ARGS)
+{
+	Datum		d = PG_GETARG_DATUM(0);
+
+	if (VARATT_IS_EXTERNAL_EXPANDED(DatumGetPointer(d)))
+		PG_RETURN_INT32(DatumGetExpandedOptBagPtr(d)->nentries);
+
+	PG_RETURN_INT32(((OptBag *) PG_DETOAST_DATUM(d))->nentries);
+}
+
+#if PG_VERSION_NUM >= 180000
+
+static bool
+contains_param_walker(Node *node, int *paramid)
+{
+	if (node == NULL)
+		return false;
+
+	if (IsA(node, Param))
+	{
+		Param	   *param = (Param *) node;
+
+		if (param->paramkind == PARAM_EXTERN &&
+			param->paramid == *paramid)
+			return true;
+	}
+
+	return expression_tree_walker(node, contains_param_walker, paramid);
+}
+
+#endif
+
+/*
+ * Planner support function of optbag_set. It allows to PL/pgSQL
+ * (18 and higher) to pass variable as read/write expanded object,
+ * when the variable is first argument, and it is not used in
+ * other arguments.
+ */
+Datum
+optbag_support(PG_FUNCTION_ARGS)
+{
+	Node	   *rawreq = (Node *) PG_GETARG_POINTER(0);
+	Node	   *ret = NULL;
+
+#if PG_VERSION_NUM >= 180000
+
+	if (IsA(rawreq, SupportRequestModifyInPlace))
+	{
+		SupportRequestModifyInPlace *req = (SupportRequestModifyInPlace *) rawreq;
+		Param	   *arg = (Param *) linitial(req->args);
+
+		if (arg && IsA(arg, Param) &&
+			arg->paramkind == PARAM_EXTERN &&
+			arg->paramid == req->paramid &&
+			!contains_param_walker((Node *) list_copy_tail(req->args, 1),
+								   &req->paramid))
+			ret = (Node *) arg;
+	}
+
+#endif
+
+	PG_RETURN_POINTER(ret);
+}
@@ -0,0 +1,157 @@
+/*-------------------------------------------------------------------------
+ *
+ * simple
+ *	  simple demo extension - cached resolution of function names
+ *
+ * Author:	Pavel Stehule
+ * Postcardware licence @2024
+ *
+ * IDENTIFICATION
+ *	  proname_cache.h
+ *
+ * needs_fmgr_hook is called by fmgr_info for every function of every
+ * query. When the hook searches functions by name (stringToQualifiedNameList
+ * and FuncnameGetCandidates), this search should not be repeated. The
+ * names are resolved together (by one check of search_path), and oids
+ * are cached until search_path or pg_proc is changed (the syscache
+ * callback is used). Missing function is not an error (the extension
+ * can be not created yet), it is cached as empty list of oids.
+ *
+ *     static const char *names[] = {"int_func", "text_func"};
+ *     static PronameCache cache = {2, names};
+ *
+ *     if (proname_cache_valid(&cache) || proname_cache_refresh(&cache))
+ *         is_hooked = list_member_oid(cache.oids[0], fn_oid);
+ *
+ * This header file has not any dependency on simple.so, so it is used
+ * by lessons too.
+ *
+ *-------------------------------------------------------------------------
+ */
+#ifndef SIMPLE_PRONAME_CACHE_H
+#define SIMPLE_PRONAME_CACHE_H
+
+#include "access/xact.h"
+#include "catalog/namespace.h"
+#include "utils/inval.h"
+#include "utils/memutils.h"
+#include "utils/regproc.h"
+#include "utils/syscache.h"
+
+#define PRONAME_CACHE_MAX_NAMES		4
+
+#if PG_VERSION_NUM >= 170000
+typedef SearchPathMatcher PronameSearchPath;
+#define GetPronameSearchPath(cxt)		GetSearchPathMatcher(cxt)
+#define PronameSearchPathMatches(path)	SearchPathMatchesCurrentEnvironment(path)
+#else
+typedef OverrideSearchPath PronameSearchPath;
+#define GetPronameSearchPath(cxt)		GetOverrideSearchPath(cxt)
+#define PronameSearchPathMatches(path)	OverrideSearchPathMatchesCurrent(path)
+#endif
+
+typedef struct PronameCache
+{
+	int			nnames;
+	const char **names;
+
+	/* oids of functions with name names[i] (all overloads) */
+	List	   *oids[PRONAME_CACHE_MAX_NAMES];
+
+	bool		valid;			/* cleaned by syscache callback */
+	bool		callbacks_registered;
+	bool		resolving;		/* protection against recursion */
+	PronameSearchPath *search_path;
+	MemoryContext cxt;
+} PronameCache;
+
+static void
+proname_cache_invalidate(Datum arg, int cacheid, uint32 hashvalue)
+{
+	PronameCache *cache = (PronameCache *) DatumGetPointer(arg);
+
+	cache->valid = false;
+}
+
+/*
+ * Returns true when cached oids can be used
+ */
+static inline bool
+proname_cache_valid(PronameCache *cache)
+{
+	return cache->valid &&
+		PronameSearchPathMatches(cache->search_path);
+}
+
+/*
+ * Searches all names. Returns false when the names cannot be resolved
+ * now (outside transaction or inside own resolving).
+ */
+static inline bool
+proname_cache_refresh(PronameCache *cache)
+{
+	MemoryContext oldcxt;
+
+	Assert(cache->nnames <= PRONAME_CACHE_MAX_NAMES);
+
+	if (cache->resolving || !IsTransactionState())
+		return false;
+
+	if (!cache->callbacks_registered)
+	{
+		CacheRegisterSyscacheCallback(PROCOID,
+									  proname_cache_invalidate,
+									  PointerGetDatum(cache));
+		CacheRegisterSyscacheCallback(NAMESPACEOID,
+									  proname_cache_invalidate,
+									  PointerGetDatum(cache));
+		cache->callbacks_registered = true;
+	}
+
+	if (cache->cxt)
+		MemoryContextReset(cache->cxt);
+	else
+		cache->cxt = AllocSetContextCreate(TopMemoryContext,
+										   "proname cache",
+										   ALLOCSET_SMALL_SIZES);
+
+	/* the callback can be called during searching */
+	cache->valid = true;
+	cache->resolving = true;
+
+	PG_TRY();
+	{
+		for (int i = 0; i < cache->nnames; i++)
+		{
+			List	   *names;
+			FuncCandidateList clist;
+
+			names = stringToQualifiedNameList(cache->names[i], NULL);
+			clist = FuncnameGetCandidates(names, -1, NIL,
+										  false, false, false, true);
+
+			oldcxt = MemoryContextSwitchTo(cache->cxt);
+
+			cache->oids[i] = NIL;
+			for (; clist; clist = clist->next)
+				cache->oids[i] = lappend_oid(cache->oids[i], clist->oid);
+
+			MemoryContextSwitchTo(oldcxt);
+		}
+
+		cache->search_path = GetPronameSearchPath(cache->cxt);
+	}
+	PG_CATCH();
+	{
+		cache->valid = false;
+		cache->resolving = false;
+		PG_RE_THROW();
+	}
+	PG_END_TRY();
+
+	cache->resolving = false;
+
+	return true;
+}
+
+#endif							/* SIMPLE_PRONAME_CACHE_H */
@@ -0,0 +1,728 @@
+/*-------------------------------------------------------------------------
+ *
+ * simple
+ *	  simple demo extension - cost of functions per query
+ *
+ * Author:	Pavel Stehule
+ * Postcardware licence @2024
+ *
+ * IDENTIFICATION
+ *	  query_stats.c
+ *
+ * When simple.track_queries is on, the fmgr hook (fmgr_hook.c) measures
+ * time of calls of int_func and text_func, and the time is attributed
+ * to the top level statement by its queryId (same like pg_stat_statements
+ * with default pg_stat_statements.track = top). The queryId is taken
+ * from post_parse_analyze_hook (functions can be evaluated by planner),
+ * from planner_hook and from ExecutorStart_hook (cached plans are not
+ * analyzed again). The queries executed inside planner, executor or
+ * utility statements (DO, CALL) are nested, and they don't change
+ * the queryId.
+ *
+ * The calls are accumulated in local hash table, and this table is
+ * flushed to shared table at the end of top level statement, so the
+ * lock of shared table is taken only once per statement. The shared
+ * table has fixed size (open addressing), and when it is full, new
+ * entries are lost.
+ *
+ *     SELECT s.query, q.funcid, q.calls, q.total_time
+ *       FROM simple_query_stats() q
+ *            JOIN pg_stat_statements s USING (queryid, dbid)
+ *      ORDER BY q.total_time DESC;
+ *
+ * The queryId is computed only when compute_query_id is enabled (it
+ * is enabled when the library is loaded by shared_preload_libraries).
+ * The shared table is allocated like trace buffer (see trace.c).
+ *
+ * Any entry has histogram of latency with power of 2 buckets (bucket i
+ * counts calls shorter than 2^i microseconds). The histograms are not
+ * returned by SQL, they are aggregated per function and exported by
+ * metrics exporter (metrics_exporter.c). The exporter has not access
+ * to system catalog, so the name of function is stored in the entry.
+ *
+ *-------------------------------------------------------------------------
+ */
+
+#include "postgres.h"
+
+#include "access/xact.h"
+#include "common/hashfn.h"
+#include "executor/executor.h"
+#include "funcapi.h"
+#include "miscadmin.h"
+#include "nodes/queryjumble.h"
+#include "optimizer/planner.h"
+#include "parser/analyze.h"
+#include "port/pg_bitutils.h"
+#include "storage/ipc.h"
+#include "storage/lwlock.h"
+#include "storage/shmem.h"
+#include "tcop/utility.h"
+#include "utils/guc.h"
+#include "utils/hsearch.h"
+#include "utils/lsyscache.h"
+#include "utils/memutils.h"
+
+#if PG_VERSION_NUM >= 170000
+#include "storage/dsm_registry.h"
+#endif
+
+#include "simple.h"
+
+PG_FUNCTION_INFO_V1(simple_query_stats);
+PG_FUNCTION_INFO_V1(simple_query_stats_reset);
+
+typedef struct QueryStatsKey
+{
+	uint64		queryid;
+	Oid			dbid;
+	Oid			fn_oid;
+} QueryStatsKey;
+
+typedef struct QueryStatsEntry
+{
+	QueryStatsKey key;			/* hash key */
+	bool		used;
+	int64		calls;
+	double		total_time;		/* in ms */
+	NameData	fn_name;
+	int64		buckets[SIMPLE_LATENCY_BUCKETS];
+} QueryStatsEntry;
+
+typedef struct QueryStatsShared
+{
+	LWLock		lock;
+	int			tranche_id;
+	uint32		size;			/* power of 2 */
+	uint32		nentries;
+	QueryStatsEntry entries[FLEXIBLE_ARRAY_MEMBER];
+} QueryStatsShared;
+
+bool		simple_track_queries = false;
+
+static int	query_stats_max = 5000;
+
+/* true, when the library is loaded by shared_preload_libraries */
+static bool query_stats_preloaded = false;
+
+static QueryStatsShared *query_stats = NULL;
+
+/* not flushed calls of this backend */
+static HTAB *local_stats = NULL;
+
+static uint64 current_query_id = 0;
+static int	nesting_level = 0;
+
+static shmem_request_hook_type prev_shmem_request_hook = NULL;
+static shmem_startup_hook_type prev_shmem_startup_hook = NULL;
+static post_parse_analyze_hook_type prev_post_parse_analyze_hook = NULL;
+static planner_hook_type prev_planner_hook = NULL;
+static ExecutorStart_hook_type prev_ExecutorStart = NULL;
+static ExecutorRun_hook_type prev_ExecutorRun = NULL;
+static ExecutorFinish_hook_type prev_ExecutorFinish = NULL;
+static ExecutorEnd_hook_type prev_ExecutorEnd = NULL;
+static ProcessUtility_hook_type prev_ProcessUtility = NULL;
+
+static uint32
+query_stats_nentries(void)
+{
+	/* the table is filled maximally to 50 % */
+	return pg_nextpower2_32((uint32) query_stats_max * 2);
+}
+
+static Size
+query_stats_shmem_size(void)
+{
+	return add_size(offsetof(QueryStatsShared, entries),
+					mul_size(query_stats_nentries(), sizeof(QueryStatsEntry)));
+}
+
+static void
+query_stats_init(void *ptr)
+{
+	QueryStatsShared *shared = (QueryStatsShared *) ptr;
+
+	shared->tranche_id = LWLockNewTrancheId();
+	LWLockInitialize(&shared->lock, shared->tranche_id);
+
+	shared->size = query_stats_nentries();
+	shared->nentries = 0;
+
+	memset(shared->entries, 0, sizeof(QueryStatsEntry) * shared->size);
+}
+
+static void
+query_stats_shmem_request(void)
+{
+	if (prev_shmem_request_hook)
+		prev_shmem_request_hook();
+
+	RequestAddinShmemSpace(query_stats_shmem_size());
+}
+
+static void
+query_stats_shmem_startup(void)
+{
+	bool		found;
+
+	if (prev_shmem_startup_hook)
+		prev_shmem_startup_hook();
+
+	LWLockAcquire(AddinShmemInitLock, LW_EXCLUSIVE);
+
+	query_stats = ShmemInitStruct("simple query stats",
+								  query_stats_shmem_size(),
+								  &found);
+	if (!found)
+		query_stats_init(query_stats);
+
+	LWLockRelease(AddinShmemInitLock);
+
+	LWLockRegisterTranche(query_stats->tranche_id, "simple_query_stats");
+}
+
+static bool
+check_track_queries(bool *newval, void **extra, GucSource source)
+{
+#if PG_VERSION_NUM < 170000
+	if (*newval && !query_stats_preloaded)
+	{
+		GUC_check_errdetail("\"simple\" must be loaded by \"shared_preload_libraries\".");
+		return false;
+	}
+#endif
+
+	return true;
+}
+
+/*
+ * Attaches the shared table. Without shared_preload_libraries the table
+ * is created by first backend that uses it.
+ */
+void
+simple_query_stats_attach(void)
+{
+	if (query_stats)
+		return;
+
+	if (query_stats_preloaded)
+		elog(ERROR, "query stats of \"simple\" are not initialized");
+
+#if PG_VERSION_NUM >= 170000
+	{
+		bool		found;
+
+		query_stats = GetNamedDSMSegment("simple query stats",
+										 query_stats_shmem_size(),
+										 query_stats_init,
+										 &found);
+
+		LWLockRegisterTranche(query_stats->tranche_id, "simple_query_stats");
+	}
+#else
+	ereport(ERROR,
+			(errcode(ERRCODE_OBJECT_NOT_IN_PREREQUISITE_STATE),
+			 errmsg("query stats are not available"),
+			 errdetail("\"simple\" must be loaded by \"shared_preload_libraries\".")));
+#endif
+}
+
+static uint32
+query_stats_hash(const QueryStatsKey *key)
+{
+	return hash_combine((uint32) murmurhash64(key->queryid),
+						hash_combine(murmurhash32(key->dbid),
+									 murmurhash32(key->fn_oid)));
+}
+
+/*
+ * Returns entry of shared table. The exclusive lock should be
+ * taken. Returns NULL when the table is full.
+ */
+static QueryStatsEntry *
+query_stats_entry(const QueryStatsKey *key)
+{
+	uint32		mask = query_stats->size - 1;
+	uint32		pos = query_stats_hash(key) & mask;
+
+	for (;;)
+	{
+		QueryStatsEntry *entry = &query_stats->entries[pos];
+
+		if (!entry->used)
+		{
+			if (query_stats->nentries >= (uint32) query_stats_max)
+				return NULL;
+
+			entry->key = *key;
+			entry->used = true;
+			entry->calls = 0;
+			entry->total_time = 0.0;
+			memset(entry->buckets, 0, sizeof(entry->buckets));
+
+			query_stats->nentries += 1;
+
+			return entry;
+		}
+
+		if (entry->key.queryid == key->queryid &&
+			entry->key.dbid == key->dbid &&
+			entry->key.fn_oid == key->fn_oid)
+			return entry;
+
+		pos = (pos + 1) & mask;
+	}
+}
+
+/*
+ * Moves local stats to shared table
+ */
+static void
+query_stats_flush(void)
+{
+	HASH_SEQ_STATUS hash_seq;
+	QueryStatsEntry *local;
+
+	if (!local_stats || hash_get_num_entries(local_stats) == 0)
+		return;
+
+	simple_query_stats_attach();
+
+	/* the catalog should not be used under lock */
+	hash_seq_init(&hash_seq, local_stats);
+	while ((local = hash_seq_search(&hash_seq)) != NULL)
+	{
+		char	   *fn_name = get_func_name(local->key.fn_oid);
+
+		namestrcpy(&local->fn_name, fn_name ? fn_name : "");
+	}
+
+	LWLockAcquire(&query_stats->lock, LW_EXCLUSIVE);
+
+	hash_seq_init(&hash_seq, local_stats);
+	while ((local = hash_seq_search(&hash_seq)) != NULL)
+	{
+		QueryStatsEntry *entry = query_stats_entry(&local->key);
+
+		if (entry)
+		{
+			entry->calls += local->calls;
+			entry->total_time += local->total_time;
+			entry->fn_name = local->fn_name;
+
+			for (int i = 0; i < SIMPLE_LATENCY_BUCKETS; i++)
+				entry->buckets[i] += local->buckets[i];
+		}
+
+		hash_search(local_stats, &local->key, HASH_REMOVE, NULL);
+	}
+
+	LWLockRelease(&query_stats->lock);
+}
+
+/*
+ * Returns bucket of latency histogram. The bucket i is used for
+ * calls shorter than 2^i us.
+ */
+static inline int
+latency_bucket(double time)
+{
+	uint64		us;
+
+	if (time < 0.001)
+		return 0;
+
+	us = (uint64) (time * 1000.0);
+
+	return Min(pg_leftmost_one_pos64(us) + 1, SIMPLE_LATENCY_BUCKETS - 1);
+}
+
+/*
+ * Called by fmgr hook after end of call. It should be fast, so
+ * only local table is updated.
+ */
+void
+simple_query_stats_add(Oid fn_oid, double time)
+{
+	QueryStatsKey key;
+	QueryStatsEntry *entry;
+	bool		found;
+
+	if (!local_stats)
+	{
+		HASHCTL		ctl;
+
+		ctl.keysize = sizeof(QueryStatsKey);
+		ctl.entrysize = sizeof(QueryStatsEntry);
+		ctl.hcxt = TopMemoryContext;
+
+		local_stats = hash_create("simple local query stats",
+								  64,
+								  &ctl,
+								  HASH_ELEM | HASH_BLOBS | HASH_CONTEXT);
+	}
+
+	key.queryid = current_query_id;
+	key.dbid = MyDatabaseId;
+	key.fn_oid = fn_oid;
+
+	entry = hash_search(local_stats, &key, HASH_ENTER, &found);
+	if (!found)
+	{
+		entry->used = true;
+		entry->calls = 0;
+		entry->total_time = 0.0;
+		memset(entry->buckets, 0, sizeof(entry->buckets));
+	}
+
+	entry->calls += 1;
+	entry->total_time += time;
+	entry->buckets[latency_bucket(time)] += 1;
+}
+
+static void
+query_stats_post_parse_analyze(ParseState *pstate, Query *query,
+							   JumbleState *jstate)
+{
+	if (prev_post_parse_analyze_hook)
+		prev_post_parse_analyze_hook(pstate, query, jstate);
+
+	if (nesting_level == 0)
+		current_query_id = query->queryId;
+}
+
+/*
+ * Cached plans can be planned again without parse analysis. The
+ * queries analyzed by planner (inlined SQL functions) are nested.
+ */
+static PlannedStmt *
+query_stats_planner(Query *parse, const char *query_string,
+					int cursorOptions, ParamListInfo boundParams)
+{
+	PlannedStmt *result;
+
+	if (nesting_level == 0)
+		current_query_id = parse->queryId;
+
+	nesting_level++;
+	PG_TRY();
+	{
+		if (prev_planner_hook)
+			result = prev_planner_hook(parse, query_string, cursorOptions,
+									   boundParams);
+		else
+			result = standard_planner(parse, query_string, cursorOptions,
+									  boundParams);
+	}
+	PG_FINALLY();
+	{
+		nesting_level--;
+	}
+	PG_END_TRY();
+
+	return result;
+}
+
+static void
+query_stats_ExecutorStart(QueryDesc *queryDesc, int eflags)
+{
+	if (nesting_level == 0)
+		current_query_id = queryDesc->plannedstmt->queryId;
+
+	if (prev_ExecutorStart)
+		prev_ExecutorStart(queryDesc, eflags);
+	else
+		standard_ExecutorStart(queryDesc, eflags);
+}
+
+#if PG_VERSION_NUM >= 180000
+
+static void
+query_stats_ExecutorRun(QueryDesc *queryDesc, ScanDirection direction,
+						uint64 count)
+{
+	nesting_level++;
+	PG_TRY();
+	{
+		if (prev_ExecutorRun)
+			prev_ExecutorRun(queryDesc, direction, count);
+		else
+			standard_ExecutorRun(queryDesc, direction, count);
+	}
+	PG_FINALLY();
+	{
+		nesting_level--;
+	}
+	PG_END_TRY();
+}
+
+#else
+
+static void
+query_stats_ExecutorRun(QueryDesc *queryDesc, ScanDirection direction,
+						uint64 count, bool execute_once)
+{
+	nesting_level++;
+	PG_TRY();
+	{
+		if (prev_ExecutorRun)
+			prev_ExecutorRun(queryDesc, direction, count, execute_once);
+		else
+			standard_ExecutorRun(queryDesc, direction, count, execute_once);
+	}
+	PG_FINALLY();
+	{
+		nesting_level--;
+	}
+	PG_END_TRY();
+}
+
+#endif
+
+static void
+query_stats_ExecutorFinish(QueryDesc *queryDesc)
+{
+	nesting_level++;
+	PG_TRY();
+	{
+		if (prev_ExecutorFinish)
+			prev_ExecutorFinish(queryDesc);
+		else
+			standard_ExecutorFinish(queryDesc);
+	}
+	PG_FINALLY();
+	{
+		nesting_level--;
+	}
+	PG_END_TRY();
+}
+
+static void
+query_stats_ExecutorEnd(QueryDesc *queryDesc)
+{
+	if (prev_ExecutorEnd)
+		prev_ExecutorEnd(queryDesc);
+	else
+		standard_ExecutorEnd(queryDesc);
+
+	/*
+	 * The calls of failed statements are flushed at the end of next
+	 * statement.
+	 */
+	if (nesting_level == 0)
+		query_stats_flush();
+}
+
+/*
+ * The queries executed by utility statements (DO, CALL, EXPLAIN
+ * ANALYZE) are attributed to the utility statement.
+ */
+static void
+query_stats_ProcessUtility(PlannedStmt *pstmt, const char *queryString,
+						   bool readOnlyTree,
+						   ProcessUtilityContext context,
+						   ParamListInfo params, QueryEnvironment *queryEnv,
+						   DestReceiver *dest, QueryCompletion *qc)
+{
+	if (nesting_level == 0)
+		current_query_id = pstmt->queryId;
+
+	nesting_level++;
+	PG_TRY();
+	{
+		if (prev_ProcessUtility)
+			prev_ProcessUtility(pstmt, queryString, readOnlyTree,
+								context, params, queryEnv,
+								dest, qc);
+		else
+			standard_ProcessUtility(pstmt, queryString, readOnlyTree,
+									context, params, queryEnv,
+									dest, qc);
+	}
+	PG_FINALLY();
+	{
+		nesting_level--;
+	}
+	PG_END_TRY();
+
+	/* the catalog cannot be used in aborted transaction (ROLLBACK) */
+	if (nesting_level == 0 && IsTransactionState())
+		query_stats_flush();
+}
+
+/*
+ * Returns the content of shared table
+ */
+Datum
+simple_query_stats(PG_FUNCTION_ARGS)
+{
+	ReturnSetInfo *rsinfo = (ReturnSetInfo *) fcinfo->resultinfo;
+
+	InitMaterializedSRF(fcinfo, 0);
+
+	simple_query_stats_attach();
+
+	/* calls of this backend should be visible immediately */
+	query_stats_flush();
+
+	LWLockAcquire(&query_stats->lock, LW_SHARED);
+
+	for (uint32 i = 0; i < query_stats->size; i++)
+	{
+		QueryStatsEntry *entry = &query_stats->entries[i];
+		Datum		values[5];
+		bool		nulls[5] = {0};
+
+		if (!entry->used)
+			continue;
+
+		values[0] = Int64GetDatum((int64) entry->key.queryid);
+		values[1] = ObjectIdGetDatum(entry->key.dbid);
+		values[2] = ObjectIdGetDatum(entry->key.fn_oid);
+		values[3] = Int64GetDatum(entry->calls);
+		values[4] = Float8GetDatum(entry->total_time);
+
+		tuplestore_putvalues(rsinfo->setResult, rsinfo->setDesc, values, nulls);
+	}
+
+	LWLockRelease(&query_stats->lock);
+
+	return (Datum) 0;
+}
+
+/*
+ * Returns the content of shared table aggregated per database and
+ * function. It doesn't use the catalog, so it can be used by background
+ * worker without database connection. Returns NULL, when the shared
+ * table is not attached.
+ */
+SimpleFunctionMetrics *
+simple_query_stats_metrics(int *nmetrics)
+{
+	SimpleFunctionMetrics *metrics;
+	int			n = 0;
+
+	*nmetrics = 0;
+
+	if (!query_stats)
+		return NULL;
+
+	LWLockAcquire(&query_stats->lock, LW_SHARED);
+
+	metrics = palloc(sizeof(SimpleFunctionMetrics) * Max(query_stats->nentries, 1));
+
+	for (uint32 i = 0; i < query_stats->size; i++)
+	{
+		QueryStatsEntry *entry = &query_stats->entries[i];
+		SimpleFunctionMetrics *m = NULL;
+
+		if (!entry->used)
+			continue;
+
+		/* there are only few hooked functions, so linear search is enough */
+		for (int j = 0; j < n; j++)
+		{
+			if (metrics[j].dbid == entry->key.dbid &&
+				metrics[j].fn_oid == entry->key.fn_oid)
+			{
+				m = &metrics[j];
+				break;
+			}
+		}
+
+		if (!m)
+		{
+			m = &metrics[n++];
+			memset(m, 0, sizeof(SimpleFunctionMetrics));
+			m->dbid = entry->key.dbid;
+			m->fn_oid = entry->key.fn_oid;
+			m->fn_name = entry->fn_name;
+		}
+
+		m->calls += entry->calls;
+		m->total_time += entry->total_time;
+
+		for (int j = 0; j < SIMPLE_LATENCY_BUCKETS; j++)
+			m->buckets[j] += entry->buckets[j];
+	}
+
+	LWLockRelease(&query_stats->lock);
+
+	*nmetrics = n;
+
+	return metrics;
+}
+
+Datum
+simple_query_stats_reset(PG_FUNCTION_ARGS)
+{
+	simple_query_stats_attach();
+
+	LWLockAcquire(&query_stats->lock, LW_EXCLUSIVE);
+
+	memset(query_stats->entries, 0, sizeof(QueryStatsEntry) * query_stats->size);
+	query_stats->nentries = 0;
+
+	LWLockRelease(&query_stats->lock);
+
+	if (local_stats)
+	{
+		hash_destroy(local_stats);
+		local_stats = NULL;
+	}
+
+	PG_RETURN_VOID();
+}
+
+void
+simple_query_stats_init(void)
+{
+	query_stats_preloaded = process_shared_preload_libraries_in_progress;
+
+	DefineCustomBoolVariable("simple.track_queries",
+							 "Collects time of int_func and text_func calls per query.",
+							 NULL,
+							 &simple_track_queries,
+							 false,
+							 PGC_SUSET,
+							 0,
+							 check_track_queries, NULL, NULL);
+
+	DefineCustomIntVariable("simple.query_stats_max",
+							"Sets the maximum number of entries of query stats.",
+							NULL,
+							&query_stats_max,
+							5000,
+							100,
+							1024 * 1024,
+							PGC_POSTMASTER,
+							0,
+							NULL, NULL, NULL);
+
+	prev_post_parse_analyze_hook = post_parse_analyze_hook;
+	post_parse_analyze_hook = query_stats_post_parse_analyze;
+	prev_planner_hook = planner_hook;
+	planner_hook = query_stats_planner;
+	prev_ExecutorStart = ExecutorStart_hook;
+	ExecutorStart_hook = query_stats_ExecutorStart;
+	prev_ExecutorRun = ExecutorRun_hook;
+	ExecutorRun_hook = query_stats_ExecutorRun;
+	prev_ExecutorFinish = ExecutorFinish_hook;
+	ExecutorFinish_hook = query_stats_ExecutorFinish;
+	prev_ExecutorEnd = ExecutorEnd_hook;
+	ExecutorEnd_hook = query_stats_ExecutorEnd;
+	prev_ProcessUtility = ProcessUtility_hook;
+	ProcessUtility_hook = query_stats_ProcessUtility;
+
+	if (!query_stats_preloaded)
+		return;
+
+	/* same like pg_stat_statements */
+	EnableQueryId();
+
+	prev_shmem_request_hook = shmem_request_hook;
+	shmem_request_hook = query_stats_shmem_request;
+
+	prev_shmem_startup_hook = shmem_startup_hook;
+	shmem_startup_hook = query_stats_shmem_startup;
+}
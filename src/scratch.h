@@ -0,0 +1,70 @@
+/*-------------------------------------------------------------------------
+ *
+ * simple
+ *	  simple demo extension - scratch memory context of function
+ *
+ * Author:	Pavel Stehule
+ * Postcardware licence @2024
+ *
+ * IDENTIFICATION
+ *	  scratch.h
+ *
+ * Row-at-a-time functions are called in the caller's context (usually
+ * per tuple context, but it can be long life context of aggregation or
+ * of PL/pgSQL function too). Temporary data (List cells, nodes, cstrings,
+ * StringInfo buffers) allocated there are released after long time or
+ * never. The scratch context is owned by FmgrInfo and it is reset at
+ * start of any call. So the function can allocate temporary data without
+ * care, and only the result is copied to the caller's context.
+ *
+ *     oldcxt = MemoryContextSwitchTo(get_scratch_context(fcinfo));
+ *     ... temporary data ...
+ *     MemoryContextSwitchTo(oldcxt);
+ *     result = copy of result
+ *
+ * This header file has not any dependency on simple.so, so it is used
+ * by lessons too.
+ *
+ *-------------------------------------------------------------------------
+ */
+#ifndef SIMPLE_SCRATCH_H
+#define SIMPLE_SCRATCH_H
+
+#include "fmgr.h"
+#include "utils/memutils.h"
+
+/*
+ * Creates (in parent) or resets the scratch context stored in *scratch.
+ * It can be used when fn_extra holds some other data.
+ */
+static inline MemoryContext
+scratch_context_reset(MemoryContext *scratch, MemoryContext parent)
+{
+	if (*scratch == NULL)
+		*scratch = AllocSetContextCreate(parent,
+										 "scratch context",
+										 ALLOCSET_DEFAULT_SIZES);
+	else
+		MemoryContextReset(*scratch);
+
+	return *scratch;
+}
+
+/*
+ * Returns scratch context of function stored in fn_extra. Without
+ * FmgrInfo (DirectFunctionCall) there is not a place for the context,
+ * and then the current memory context is used.
+ */
+static inline MemoryContext
+get_scratch_context(FunctionCallInfo fcinfo)
+{
+	FmgrInfo   *flinfo = fcinfo->flinfo;
+
+	if (!flinfo)
+		return CurrentMemoryContext;
+
+	return scratch_context_reset((MemoryContext *) &flinfo->fn_extra,
+								 flinfo->fn_mcxt);
+}
+
+#endif							/* SIMPLE_SCRATCH_H */
@@ -15,7 +15,16 @@
 #include "postgres.h"
 #include "varatt.h"
 
+#include "catalog/pg_type.h"
+#include "mb/pg_wchar.h"
+#include "nodes/supportnodes.h"
+#include "utils/array.h"
 #include "utils/builtins.h"
+#include "utils/guc.h"
+#include "utils/memutils.h"
+
+#include "scratch.h"
+#include "simple.h"
 
 /*
  * Module signature - the extension should be compiled
@@ -32,21 +41,140 @@ PG_MODULE_MAGIC;
  */
 PG_FUNCTION_INFO_V1(int_func);
 PG_FUNCTION_INFO_V1(text_func);
+PG_FUNCTION_INFO_V1(int_func_int2);
+PG_FUNCTION_INFO_V1(int_func_int8);
+PG_FUNCTION_INFO_V1(int_func_array);
+PG_FUNCTION_INFO_V1(int_func_array_support);
 
 /*
  * Usage of V1 call convention macros
+ *
+ * The overflow is checked by compiler's builtins (see common/int.h).
+ * It is as safe as DirectFunctionCall2(int4pl, ...), but without
+ * an overhead of building FunctionCallInfo for every call.
  */
 Datum
 int_func(PG_FUNCTION_ARGS)
 {
 	int32	arg = PG_GETARG_INT32(0);
+	int32	result;
+
+	if (unlikely(int_func_kernel(arg, &result)))
+		ereport(ERROR,
+				(errcode(ERRCODE_NUMERIC_VALUE_OUT_OF_RANGE),
+				 errmsg("integer out of range")));
+
+	PG_RETURN_INT32(result);
+}
+
+Datum
+int_func_int2(PG_FUNCTION_ARGS)
+{
+	int16	arg = PG_GETARG_INT16(0);
+	int16	result;
+
+	if (unlikely(pg_add_s16_overflow(arg, INT_FUNC_INCREMENT, &result)))
+		ereport(ERROR,
+				(errcode(ERRCODE_NUMERIC_VALUE_OUT_OF_RANGE),
+				 errmsg("smallint out of range")));
+
+	PG_RETURN_INT16(result);
+}
+
+Datum
+int_func_int8(PG_FUNCTION_ARGS)
+{
+	int64	arg = PG_GETARG_INT64(0);
+	int64	result;
+
+	if (unlikely(pg_add_s64_overflow(arg, INT_FUNC_INCREMENT, &result)))
+		ereport(ERROR,
+				(errcode(ERRCODE_NUMERIC_VALUE_OUT_OF_RANGE),
+				 errmsg("bigint out of range")));
+
+	PG_RETURN_INT64(result);
+}
+
+/*
+ * int_func for all fields of array. The array is expanded (see
+ * utils/expandeddatum.h). When the argument is read/write expanded
+ * array (PL/pgSQL variable passed by int_func_array_support), it is
+ * modified in place and returned without copying. Elsewhere a copy
+ * is expanded and modified. The overflow is checked before any
+ * change, so the variable is not changed partially after an error.
+ */
+Datum
+int_func_array(PG_FUNCTION_ARGS)
+{
+	ExpandedArrayHeader *eah = PG_GETARG_EXPANDED_ARRAYX(0, NULL);
+	int32		result;
+
+	if (eah->element_type != INT4OID)
+		elog(ERROR, "array of integers is expected");
+
+	deconstruct_expanded_array(eah);
+
+	for (int i = 0; i < eah->nelems; i++)
+	{
+		if (eah->dnulls && eah->dnulls[i])
+			continue;
+
+		if (unlikely(int_func_kernel(DatumGetInt32(eah->dvalues[i]), &result)))
+			ereport(ERROR,
+					(errcode(ERRCODE_NUMERIC_VALUE_OUT_OF_RANGE),
+					 errmsg("integer out of range")));
+	}
+
+	for (int i = 0; i < eah->nelems; i++)
+	{
+		if (eah->dnulls && eah->dnulls[i])
+			continue;
+
+		(void) int_func_kernel(DatumGetInt32(eah->dvalues[i]), &result);
+		eah->dvalues[i] = Int32GetDatum(result);
+	}
+
+	/* the flat value (when it exists) is not valid now */
+	eah->fvalue = NULL;
+	eah->flat_size = 0;
+
+	PG_RETURN_DATUM(EOHPGetRWDatum(&eah->hdr));
+}
+
+/*
+ * Planner support function of int_func(int[]). PL/pgSQL (18 and
+ * higher) asks if the variable can be passed as read/write expanded
+ * object. It is possible, because the only argument is modified
+ * only after all checks.
+ */
+Datum
+int_func_array_support(PG_FUNCTION_ARGS)
+{
+	Node	   *rawreq = (Node *) PG_GETARG_POINTER(0);
+	Node	   *ret = NULL;
+
+#if PG_VERSION_NUM >= 180000
+
+	if (IsA(rawreq, SupportRequestModifyInPlace))
+	{
+		SupportRequestModifyInPlace *req = (SupportRequestModifyInPlace *) rawreq;
+		Param	   *arg = (Param *) linitial(req->args);
+
+		if (arg && IsA(arg, Param) &&
+			arg->paramkind == PARAM_EXTERN &&
+			arg->paramid == req->paramid)
+			ret = (Node *) arg;
+	}
+
+#endif
 
-	PG_RETURN_INT32(arg + 10);
+	PG_RETURN_POINTER(ret);
 }
 
 /*
- * This function is not marked as STRICT, so call with NULL
- * should to fail (NULL is not handled yet). You should to
+ * This function is not marked as STRICT, so NULL should be
+ * handled. In lessons simple_0.c and simple_1.c it is not
+ * handled, and call with NULL fails there. You should to
  * use gdb to attach process and catch SIGSEGV.
  *
  * For extension development use the PostgreSQL buuild with
@@ -66,25 +194,109 @@ int_func(PG_FUNCTION_ARGS)
  * from/to C string. You can see a StringInfo related functions.
  * StringInfo allows comfortable work with dynamicaly sized C strings.
  * StringInfo functions are very fast, but there is some memory
- * overhead (usually can be accepted).
+ * overhead (usually can be accepted). When the size of result is
+ * known, then the result can be allocated and filled directly
+ * (see simple_0.c).
+ *
+ * The string literals in source code are in UTF8, but the text
+ * values are in database encoding. The suffix is converted to
+ * database encoding once per backend. The input string is valid
+ * (any text value is validated by its input function), the
+ * suffix is valid, and then the result is valid too, and it is
+ * not necessary to check it.
+ */
+const char *
+get_text_func_suffix(int *len)
+{
+	static char *suffix = NULL;
+	static int	suffix_len = 0;
+
+	if (!suffix)
+	{
+		const char *str = ", světe";
+		char	   *converted;
+
+		/* raises an error when the suffix cannot be converted */
+		converted = pg_any_to_server(str, strlen(str), PG_UTF8);
+
+		suffix = MemoryContextStrdup(TopMemoryContext, converted);
+		suffix_len = strlen(suffix);
+
+		if (converted != str)
+			pfree(converted);
+	}
+
+	*len = suffix_len;
+
+	return suffix;
+}
+
+/*
+ * The kernel of text_func. Only one allocation, and every byte is
+ * copied only once. It is used by text_func_parallel workers too.
  */
+text *
+text_func_concat(const char *str, int len, const char *suffix, int suffix_len)
+{
+	text	   *result;
+
+	result = (text *) palloc(len + suffix_len + VARHDRSZ);
+
+	memcpy(VARDATA(result), str, len);
+	memcpy(VARDATA(result) + len, suffix, suffix_len);
+
+	SET_VARSIZE(result, len + suffix_len + VARHDRSZ);
+
+	return result;
+}
+
 Datum
 text_func(PG_FUNCTION_ARGS)
 {
-	text	   *t = PG_GETARG_TEXT_PP(0);
-	text	   *result;
-	StringInfoData str;
+	text	   *t;
+	const char *suffix;
+	int			suffix_len;
+	MemoryContext oldcxt;
 
-	elog(NOTICE, "input string is: \"%s\"", text_to_cstring(t));
+	if (PG_ARGISNULL(0))
+		PG_RETURN_NULL();
 
-	initStringInfo(&str);
+	suffix = get_text_func_suffix(&suffix_len);
 
-	appendBinaryStringInfo(&str, VARDATA_ANY(t), VARSIZE_ANY_EXHDR(t));
-	appendStringInfoString(&str, ", světe");
+	/*
+	 * Detoasted argument and cstring for NOTICE are temporary, they
+	 * are allocated in scratch context (see scratch.h).
+	 */
+	oldcxt = MemoryContextSwitchTo(get_scratch_context(fcinfo));
 
-	result = cstring_to_text_with_len(str.data, str.len);
+	t = PG_GETARG_TEXT_PP(0);
 
-	pfree(str.data);
+	elog(NOTICE, "input string is: \"%s\"", text_to_cstring(t));
+
+	MemoryContextSwitchTo(oldcxt);
+
+	PG_RETURN_TEXT_P(text_func_concat(VARDATA_ANY(t), VARSIZE_ANY_EXHDR(t),
+									  suffix, suffix_len));
+}
+
+/*
+ * Module init function. The library is loaded by first call
+ * of some function, by LOAD command or by shared_preload_libraries.
+ * The planner hooks are active only after loading, so LOAD or
+ * session_preload_libraries should be used when the custom scan
+ * should be used from first query.
+ */
+void
+_PG_init(void)
+{
+	simple_batch_scan_init();
+	simple_fmgr_hook_init();
+	simple_trace_init();
+	simple_query_stats_init();
+	simple_metrics_exporter_init();
+	simple_spi_stats_init();
+	simple_spi_pipeline_init();
+	simple_adaptive_init();
 
-	PG_RETURN_TEXT_P(result);
+	MarkGUCPrefixReserved("simple");
 }
@@ -0,0 +1,106 @@
+/*-------------------------------------------------------------------------
+ *
+ * simple
+ *	  simple demo extension - shared declarations
+ *
+ * Author:	Pavel Stehule
+ * Postcardware licence @2024
+ *
+ * IDENTIFICATION
+ *	  simple.h
+ *
+ *-------------------------------------------------------------------------
+ */
+#ifndef SIMPLE_H
+#define SIMPLE_H
+
+#include "common/int.h"
+#include "fmgr.h"
+#include "portability/instr_time.h"
+
+/* simple.c */
+extern PGDLLEXPORT Datum int_func(PG_FUNCTION_ARGS);
+extern PGDLLEXPORT Datum text_func(PG_FUNCTION_ARGS);
+extern PGDLLEXPORT Datum int_func_int2(PG_FUNCTION_ARGS);
+extern PGDLLEXPORT Datum int_func_int8(PG_FUNCTION_ARGS);
+extern PGDLLEXPORT Datum int_func_array(PG_FUNCTION_ARGS);
+
+extern const char *get_text_func_suffix(int *len);
+extern text *text_func_concat(const char *str, int len,
+							  const char *suffix, int suffix_len);
+
+/* adaptive.c */
+extern void simple_adaptive_init(void);
+
+/* batch_scan.c */
+extern void simple_batch_scan_init(void);
+
+/* fmgr_hook.c */
+extern void simple_fmgr_hook_init(void);
+
+/* trace.c */
+extern PGDLLIMPORT bool simple_trace_calls;
+
+extern void simple_trace_attach(void);
+extern void simple_trace_event(Oid fn_oid, FmgrHookEventType event);
+extern void simple_trace_init(void);
+
+/* query_stats.c */
+extern PGDLLIMPORT bool simple_track_queries;
+
+#define SIMPLE_LATENCY_BUCKETS		21
+
+/*
+ * Calls of hooked function in one database. The histogram is not
+ * cumulative, bucket i counts calls shorter than 2^i microseconds
+ * (and not shorter than 2^(i-1)), last bucket counts longer calls.
+ */
+typedef struct SimpleFunctionMetrics
+{
+	Oid			dbid;
+	Oid			fn_oid;
+	NameData	fn_name;
+	int64		calls;
+	double		total_time;		/* in ms */
+	int64		buckets[SIMPLE_LATENCY_BUCKETS];
+} SimpleFunctionMetrics;
+
+extern void simple_query_stats_attach(void);
+extern void simple_query_stats_add(Oid fn_oid, double time);
+extern SimpleFunctionMetrics *simple_query_stats_metrics(int *nmetrics);
+extern void simple_query_stats_init(void);
+
+/* metrics_exporter.c */
+extern void simple_metrics_exporter_init(void);
+
+/* spi_stats.c */
+extern void simple_spi_stats_report(Oid fn_oid, int64 executions, int64 rows,
+									instr_time time);
+extern void simple_spi_stats_init(void);
+
+/* spi_pipeline.c */
+typedef struct SimplePipeline SimplePipeline;
+
+extern SimplePipeline *simple_pipeline_create(Oid fn_oid, bool read_only);
+extern int	simple_pipeline_queue(SimplePipeline *pipeline, const char *query,
+								  int nargs, Oid *argtypes,
+								  Datum *values, bool *nulls);
+extern void simple_pipeline_execute(SimplePipeline *pipeline);
+extern Datum simple_pipeline_result(SimplePipeline *pipeline, int n, bool *isnull);
+extern void simple_pipeline_free(SimplePipeline *pipeline);
+extern void simple_spi_pipeline_init(void);
+
+#define INT_FUNC_INCREMENT		10
+
+/*
+ * The computation of int_func. Returns true, when the result
+ * overflows. The batch evaluation in custom scan (batch_scan.c)
+ * should to return same values (and errors).
+ */
+static inline bool
+int_func_kernel(int32 arg, int32 *result)
+{
+	return pg_add_s32_overflow(arg, INT_FUNC_INCREMENT, result);
+}
+
+#endif							/* SIMPLE_H */
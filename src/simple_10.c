@@ -20,6 +20,8 @@
 #include "utils/builtins.h"
 #include "utils/regproc.h"
 
+#include "proname_cache.h"
+
 PG_MODULE_MAGIC;
 
 PG_FUNCTION_INFO_V1(int_func);
@@ -28,6 +30,9 @@ PG_FUNCTION_INFO_V1(text_func);
 static needs_fmgr_hook_type prev_needs_fmgr_hook = NULL;
 static fmgr_hook_type prev_fmgr_hook = NULL;
 
+static const char *proname_cache_names[] = {"text_func", "int_func"};
+static PronameCache proname_cache = {lengthof(proname_cache_names), proname_cache_names};
+
 static Oid text_func_oid = InvalidOid;
 static Oid int_func_oid = InvalidOid;
 
@@ -84,21 +89,18 @@ text_func(PG_FUNCTION_ARGS)
 	PG_RETURN_TEXT_P(result);
 }
 
+/*
+ * Returns oid of i-th name of proname_cache. When the function is
+ * not created yet, or when it is not unique, the function is not
+ * hooked (errors in needs_fmgr_hook break any query).
+ */
 static Oid
-get_proname_oid(const char *proname)
+get_proname_oid(int i)
 {
-	List	   *names;
-	FuncCandidateList clist;
-
-	names = stringToQualifiedNameList(proname, NULL);
-	clist = FuncnameGetCandidates(names, -1, NIL, false, false, false, true);
+	if (list_length(proname_cache.oids[i]) != 1)
+		return InvalidOid;
 
-	if (clist == NULL)
-		elog(ERROR, "function \"%s\" doesn't exists", proname);
-	else if (clist->next != NULL)
-		elog(ERROR, "more than one function named \"%s\"", proname);
-
-	return clist->oid;
+	return linitial_oid(proname_cache.oids[i]);
 }
 
 static bool
@@ -108,10 +110,17 @@ simple_needs_fmgr_hook(Oid fn_oid)
 		(*prev_needs_fmgr_hook) (fn_oid))
 		return true;
 
-	if (!OidIsValid(text_func_oid))
+	/*
+	 * This hook is called for every function, so the names are searched
+	 * only after change of search_path or pg_proc.
+	 */
+	if (!proname_cache_valid(&proname_cache))
 	{
-		text_func_oid = get_proname_oid("text_func");
-		int_func_oid = get_proname_oid("int_func");
+		if (!proname_cache_refresh(&proname_cache))
+			return false;
+
+		text_func_oid = get_proname_oid(0);
+		int_func_oid = get_proname_oid(1);
 	}
 
 	return fn_oid == text_func_oid || fn_oid == int_func_oid;
@@ -147,8 +156,6 @@ simple_fmgr_hook(FmgrHookEventType event,
 		MemoryContext oldcxt = MemoryContextSwitchTo(flinfo->fn_mcxt);
 
 		Assert(event == FHET_START);
-		Assert(OidIsValid(text_func_oid));
-		Assert(OidIsValid(int_func_oid));
 
 		fcache = palloc0(sizeof(simple_fmgr_cache));
 
@@ -19,6 +19,8 @@
 #include "executor/spi.h"
 #include "utils/builtins.h"
 
+#include "spi_wait.h"
+
 PG_MODULE_MAGIC;
 
 PG_FUNCTION_INFO_V1(int_func);
@@ -71,10 +73,14 @@ text_func(PG_FUNCTION_ARGS)
 
 	SPI_connect();
 
+	pgstat_report_wait_start(simple_spi_wait_event());
+
 	res = SPI_execute_with_args("SELECT $1 || ', světe'",
 							  1, types, args, nulls,
 							  true, 1);
 
+	pgstat_report_wait_end();
+
 	if (res == SPI_OK_SELECT)
 	{
 		TupleDesc   tupdesc;
@@ -21,6 +21,8 @@
 #include "utils/datum.h"
 #include "utils/lsyscache.h"
 
+#include "spi_wait.h"
+
 PG_MODULE_MAGIC;
 
 PG_FUNCTION_INFO_V1(int_func);
@@ -68,10 +70,14 @@ text_func(PG_FUNCTION_ARGS)
 
 	SPI_connect();
 
+	pgstat_report_wait_start(simple_spi_wait_event());
+
 	res = SPI_execute_with_args("SELECT ($1 || ', světe')::text",
 							  1, types, args, nulls,
 							  true, 1);
 
+	pgstat_report_wait_end();
+
 	if (res == SPI_OK_SELECT)
 	{
 		TupleDesc   tupdesc;
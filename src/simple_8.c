@@ -19,6 +19,8 @@
 #include "nodes/value.h"
 #include "utils/builtins.h"
 
+#include "scratch.h"
+
 PG_MODULE_MAGIC;
 
 PG_FUNCTION_INFO_V1(int_func);
@@ -65,10 +67,19 @@ text_func(PG_FUNCTION_ARGS)
 {
 	text	   *t;
 	List	   *strings = NIL;
+	char	   *str;
+	MemoryContext oldcxt;
 
 	if (PG_ARGISNULL(0))
 		PG_RETURN_NULL();
 
+	/*
+	 * List cells, String nodes and cstrings are temporary. They are
+	 * allocated in scratch context, that is reset on every call, and
+	 * only result is created in caller's context.
+	 */
+	oldcxt = MemoryContextSwitchTo(get_scratch_context(fcinfo));
+
 	t = PG_GETARG_TEXT_PP(0);
 
 	elog(NOTICE, "input string is: \"%s\"", text_to_cstring(t));
@@ -76,5 +87,9 @@ text_func(PG_FUNCTION_ARGS)
 	strings = lappend(strings, makeString(text_to_cstring(t)));
 	strings = lappend(strings, makeString(", světe"));
 
-	PG_RETURN_TEXT_P(cstring_to_text(concat_list(strings)));
+	str = concat_list(strings);
+
+	MemoryContextSwitchTo(oldcxt);
+
+	PG_RETURN_TEXT_P(cstring_to_text(str));
 }
@@ -21,6 +21,8 @@
 #include "nodes/value.h"
 #include "utils/builtins.h"
 
+#include "scratch.h"
+
 PG_MODULE_MAGIC;
 
 PG_FUNCTION_INFO_V1(int_func);
@@ -89,6 +91,8 @@ text_func(PG_FUNCTION_ARGS)
 	text	   *t;
 	List	   *vals = NIL;
 	DefElem	   *defelem = NULL;
+	char	   *str;
+	MemoryContext oldcxt;
 
 	if (PG_ARGISNULL(0))
 		ereport(ERROR,
@@ -96,6 +100,12 @@ text_func(PG_FUNCTION_ARGS)
 				 errmsg("argument of text func cannot be null"),
 				 errhint("use non null value")));
 
+	/*
+	 * Temporary data are allocated in scratch context, that is
+	 * reset on every call (see simple_8.c).
+	 */
+	oldcxt = MemoryContextSwitchTo(get_scratch_context(fcinfo));
+
 	t = PG_GETARG_TEXT_PP(0);
 
 	elog(NOTICE, "input string is: \"%s\"", text_to_cstring(t));
@@ -115,5 +125,9 @@ text_func(PG_FUNCTION_ARGS)
 
 	elog_node_display(NOTICE, "*** debug output ****", vals, true);
 
-	PG_RETURN_TEXT_P(cstring_to_text(concat_list(vals, ", ")));
+	str = concat_list(vals, ", ");
+
+	MemoryContextSwitchTo(oldcxt);
+
+	PG_RETURN_TEXT_P(cstring_to_text(str));
 }
@@ -0,0 +1,783 @@
+/*-------------------------------------------------------------------------
+ *
+ * simple
+ *	  simple demo extension - pipeline of SPI queries
+ *
+ * Author:	Pavel Stehule
+ * Postcardware licence @2024
+ *
+ * IDENTIFICATION
+ *	  spi_pipeline.c
+ *
+ * The lessons simple_3.c .. simple_7.c execute one query per call. Any
+ * call does SPI_connect, parses and plans the query, executes it (with
+ * new snapshot for not read only query) and SPI_finish. When the function
+ * needs results of more independent queries (lookups for more values),
+ * this overhead can be reduced:
+ *
+ *     pipeline = simple_pipeline_create(fcinfo->flinfo->fn_oid, true);
+ *
+ *     for (i = 0; i < n; i++)
+ *         simple_pipeline_queue(pipeline, query, 1, argtypes, &values[i], NULL);
+ *
+ *     simple_pipeline_execute(pipeline);
+ *
+ *     for (i = 0; i < n; i++)
+ *         result[i] = simple_pipeline_result(pipeline, i, &isnull[i]);
+ *
+ *     simple_pipeline_free(pipeline);
+ *
+ * All queries are executed inside one SPI connection with one snapshot,
+ * and the plans are saved (SPI_keepplan) and reused by later calls. The
+ * number of saved plans is limited, the least recently used plan (not
+ * used by some living pipeline) is released first.
+ * The result of query is the value of first column of first row (NULL,
+ * when the query returns no row).
+ *
+ * Queries without tables like "SELECT $1 || 'x'" are very common. When
+ * the expression is immutable, then it is evaluated directly by executor
+ * (like simple expressions in PL/pgSQL) without portal and snapshot. The
+ * fast path can be disabled by simple.pipeline_fast_path.
+ *
+ * The SPI execution is visible in pg_stat_activity as wait event (see
+ * spi_wait.h), and executions, rows and time are counted per function
+ * passed to simple_pipeline_create (see spi_stats.c).
+ *
+ *-------------------------------------------------------------------------
+ */
+
+#include "postgres.h"
+
+#include "catalog/pg_type.h"
+#include "common/hashfn.h"
+#include "executor/executor.h"
+#include "executor/spi.h"
+#include "lib/ilist.h"
+#include "nodes/nodeFuncs.h"
+#include "optimizer/optimizer.h"
+#include "portability/instr_time.h"
+#include "utils/array.h"
+#include "utils/builtins.h"
+#include "utils/datum.h"
+#include "utils/guc.h"
+#include "utils/hsearch.h"
+#include "utils/lsyscache.h"
+#include "utils/memutils.h"
+#include "utils/plancache.h"
+#include "utils/resowner.h"
+#include "utils/snapmgr.h"
+
+#include "simple.h"
+#include "spi_wait.h"
+
+PG_FUNCTION_INFO_V1(text_func_batch);
+
+/* maximal number of saved statements (when they are not used) */
+#define PIPELINE_MAX_STATEMENTS		256
+
+typedef struct PipelineStatementKey
+{
+	const char *query;
+	int			nargs;
+	const Oid  *argtypes;
+} PipelineStatementKey;
+
+/*
+ * Saved plans are shared by all pipelines. The statement used by
+ * some pipeline (refcount > 0) is not released.
+ */
+typedef struct PipelineStatement
+{
+	PipelineStatementKey key;	/* hash key */
+	dlist_node	lru_node;		/* the most recently used is first */
+	int			refcount;		/* number of queued queries */
+	SPIPlanPtr	plan;			/* NULL, when it is not prepared yet */
+	bool		is_simple;		/* query has not tables (see above) */
+
+	/*
+	 * State of simple expression evaluation. It is valid only inside
+	 * execution with same exec_id. The used cached plans are released
+	 * by the execution that acquired them (the statement can be used
+	 * by nested pipeline too).
+	 */
+	uint64		exec_id;
+	ExprState  *exprstate;
+	ParamListInfo params;
+	int16		typlen;
+	bool		typbyval;
+} PipelineStatement;
+
+typedef struct PipelineQuery
+{
+	PipelineStatement *stmt;
+	Datum	   *values;
+	char	   *nulls;
+	Datum		result;
+	bool		isnull;
+} PipelineQuery;
+
+struct SimplePipeline
+{
+	MemoryContext cxt;			/* queued queries and results */
+	Oid			fn_oid;			/* SPI statistics are counted for this function */
+	bool		read_only;
+	bool		executed;
+	int			nqueries;
+	int			maxqueries;
+	PipelineQuery *queries;
+	MemoryContextCallback release_cb;	/* releases used statements */
+};
+
+static MemoryContext pipeline_statements_cxt = NULL;
+static HTAB *pipeline_statements = NULL;
+static dlist_head pipeline_statements_lru = DLIST_STATIC_INIT(pipeline_statements_lru);
+
+static uint64 pipeline_exec_id = 0;
+
+static bool pipeline_fast_path = true;
+
+static uint32
+pipeline_statement_hash(const void *key, Size keysize)
+{
+	const PipelineStatementKey *k = (const PipelineStatementKey *) key;
+	uint32		h;
+
+	h = hash_bytes((const unsigned char *) k->query, strlen(k->query));
+
+	if (k->nargs > 0)
+		h = hash_combine(h, hash_bytes((const unsigned char *) k->argtypes,
+									   sizeof(Oid) * k->nargs));
+
+	return h;
+}
+
+static int
+pipeline_statement_match(const void *key1, const void *key2, Size keysize)
+{
+	const PipelineStatementKey *k1 = (const PipelineStatementKey *) key1;
+	const PipelineStatementKey *k2 = (const PipelineStatementKey *) key2;
+
+	if (k1->nargs != k2->nargs ||
+		strcmp(k1->query, k2->query) != 0)
+		return 1;
+
+	if (k1->nargs > 0 &&
+		memcmp(k1->argtypes, k2->argtypes, sizeof(Oid) * k1->nargs) != 0)
+		return 1;
+
+	return 0;
+}
+
+/*
+ * Releases least recently used statements, that are not used by
+ * any pipeline, so there is a place for new statement. When all
+ * statements are used, the limit is exceeded.
+ */
+static void
+pipeline_statements_evict(void)
+{
+	long		nstatements = hash_get_num_entries(pipeline_statements);
+	dlist_node *node;
+
+	if (dlist_is_empty(&pipeline_statements_lru))
+		return;
+
+	/* from the least recently used */
+	node = dlist_tail_node(&pipeline_statements_lru);
+
+	while (node && nstatements >= PIPELINE_MAX_STATEMENTS)
+	{
+		PipelineStatement *stmt;
+		PipelineStatementKey key;
+		dlist_node *prev;
+
+		prev = dlist_has_prev(&pipeline_statements_lru, node) ?
+			dlist_prev_node(&pipeline_statements_lru, node) : NULL;
+
+		stmt = dlist_container(PipelineStatement, lru_node, node);
+		node = prev;
+
+		if (stmt->refcount > 0)
+			continue;
+
+		dlist_delete(&stmt->lru_node);
+
+		if (stmt->plan)
+			SPI_freeplan(stmt->plan);
+
+		/* the key is used by hash_search, so it is released after */
+		key = stmt->key;
+		hash_search(pipeline_statements, &key, HASH_REMOVE, NULL);
+
+		pfree((char *) key.query);
+		if (key.argtypes)
+			pfree((Oid *) key.argtypes);
+
+		nstatements -= 1;
+	}
+}
+
+/*
+ * Returns an entry of saved statements. The plan is prepared
+ * later, when the SPI is connected.
+ */
+static PipelineStatement *
+get_pipeline_statement(const char *query, int nargs, Oid *argtypes)
+{
+	PipelineStatementKey key;
+	PipelineStatement *stmt;
+	bool		found;
+
+	if (!pipeline_statements)
+	{
+		HASHCTL		ctl;
+
+		pipeline_statements_cxt = AllocSetContextCreate(TopMemoryContext,
+														"simple pipeline statements",
+														ALLOCSET_DEFAULT_SIZES);
+
+		ctl.keysize = sizeof(PipelineStatementKey);
+		ctl.entrysize = sizeof(PipelineStatement);
+		ctl.hash = pipeline_statement_hash;
+		ctl.match = pipeline_statement_match;
+		ctl.hcxt = pipeline_statements_cxt;
+
+		pipeline_statements = hash_create("simple pipeline statements",
+										  64,
+										  &ctl,
+										  HASH_ELEM | HASH_FUNCTION | HASH_COMPARE | HASH_CONTEXT);
+	}
+
+	key.query = query;
+	key.nargs = nargs;
+	key.argtypes = argtypes;
+
+	stmt = hash_search(pipeline_statements, &key, HASH_FIND, NULL);
+	if (stmt)
+	{
+		dlist_move_head(&pipeline_statements_lru, &stmt->lru_node);
+		return stmt;
+	}
+
+	pipeline_statements_evict();
+
+	stmt = hash_search(pipeline_statements, &key, HASH_ENTER, &found);
+	Assert(!found);
+
+	/* the key should not point to memory of caller */
+	stmt->key.query = MemoryContextStrdup(pipeline_statements_cxt, query);
+	stmt->key.nargs = nargs;
+	stmt->key.argtypes = NULL;
+	if (nargs > 0)
+	{
+		Oid		   *types = MemoryContextAlloc(pipeline_statements_cxt,
+											   sizeof(Oid) * nargs);
+
+		memcpy(types, argtypes, sizeof(Oid) * nargs);
+		stmt->key.argtypes = types;
+	}
+
+	stmt->refcount = 0;
+	stmt->plan = NULL;
+	stmt->is_simple = false;
+	stmt->exec_id = 0;
+	stmt->exprstate = NULL;
+
+	dlist_push_head(&pipeline_statements_lru, &stmt->lru_node);
+
+	return stmt;
+}
+
+/*
+ * The statements are used by pipeline until its memory context is
+ * deleted (by simple_pipeline_free or by release of parent context
+ * after an error).
+ */
+static void
+pipeline_release_statements(void *arg)
+{
+	SimplePipeline *pipeline = (SimplePipeline *) arg;
+
+	for (int i = 0; i < pipeline->nqueries; i++)
+		pipeline->queries[i].stmt->refcount -= 1;
+
+	pipeline->nqueries = 0;
+}
+
+/*
+ * Returns true, when the query is SELECT of one expression
+ * without tables (the check is similar to exec_simple_check_plan
+ * in PL/pgSQL).
+ */
+static bool
+is_simple_query(SPIPlanPtr plan)
+{
+	List	   *plansources = SPI_plan_get_plan_sources(plan);
+	CachedPlanSource *plansource;
+	Query	   *query;
+
+	if (list_length(plansources) != 1)
+		return false;
+
+	plansource = (CachedPlanSource *) linitial(plansources);
+
+	if (list_length(plansource->query_list) != 1)
+		return false;
+
+	query = linitial_node(Query, plansource->query_list);
+
+	if (query->commandType != CMD_SELECT ||
+		query->rtable != NIL ||
+		query->jointree->fromlist != NIL ||
+		query->jointree->quals != NULL ||
+		query->hasAggs ||
+		query->hasWindowFuncs ||
+		query->hasTargetSRFs ||
+		query->hasSubLinks ||
+		query->cteList != NIL ||
+		query->groupClause != NIL ||
+		query->groupingSets != NIL ||
+		query->havingQual != NULL ||
+		query->windowClause != NIL ||
+		query->distinctClause != NIL ||
+		query->sortClause != NIL ||
+		query->limitOffset != NULL ||
+		query->limitCount != NULL ||
+		query->setOperations != NULL)
+		return false;
+
+	return list_length(query->targetList) == 1;
+}
+
+/*
+ * Prepares the evaluation of simple expression for current execution.
+ * The plan is taken from plan cache (so it is revalidated after any
+ * change of used functions). The acquired plan is appended to cplans
+ * list. Returns false, when the expression cannot be evaluated directly.
+ */
+static bool
+simple_expr_init(PipelineStatement *stmt, uint64 exec_id,
+				 MemoryContext exec_cxt, List **cplans)
+{
+	CachedPlan *cplan;
+	PlannedStmt *pstmt;
+	Plan	   *plan;
+	Expr	   *expr;
+	MemoryContext oldcxt;
+
+	if (stmt->exec_id == exec_id)
+		return stmt->exprstate != NULL;
+
+	stmt->exec_id = exec_id;
+	stmt->exprstate = NULL;
+
+	cplan = SPI_plan_get_cached_plan(stmt->plan);
+	if (!cplan)
+		return false;
+
+	pstmt = linitial_node(PlannedStmt, cplan->stmt_list);
+	plan = pstmt->planTree;
+
+	if (!IsA(plan, Result) ||
+		plan->lefttree != NULL ||
+		plan->qual != NIL ||
+		((Result *) plan)->resconstantqual != NULL ||
+		list_length(plan->targetlist) != 1)
+	{
+		ReleaseCachedPlan(cplan, CurrentResourceOwner);
+		return false;
+	}
+
+	expr = ((TargetEntry *) linitial(plan->targetlist))->expr;
+
+	/* volatile or stable functions can require snapshot */
+	if (contain_mutable_functions((Node *) expr))
+	{
+		ReleaseCachedPlan(cplan, CurrentResourceOwner);
+		return false;
+	}
+
+	oldcxt = MemoryContextSwitchTo(exec_cxt);
+
+	stmt->params = makeParamList(stmt->key.nargs);
+	for (int i = 0; i < stmt->key.nargs; i++)
+	{
+		stmt->params->params[i].ptype = stmt->key.argtypes[i];
+		stmt->params->params[i].pflags = PARAM_FLAG_CONST;
+	}
+
+	stmt->exprstate = ExecInitExprWithParams(expr, stmt->params);
+	get_typlenbyval(exprType((Node *) expr), &stmt->typlen, &stmt->typbyval);
+
+	*cplans = lappend(*cplans, cplan);
+
+	MemoryContextSwitchTo(oldcxt);
+
+	return true;
+}
+
+SimplePipeline *
+simple_pipeline_create(Oid fn_oid, bool read_only)
+{
+	MemoryContext cxt;
+	SimplePipeline *pipeline;
+
+	cxt = AllocSetContextCreate(CurrentMemoryContext,
+								"simple pipeline",
+								ALLOCSET_DEFAULT_SIZES);
+
+	pipeline = MemoryContextAllocZero(cxt, sizeof(SimplePipeline));
+	pipeline->cxt = cxt;
+	pipeline->fn_oid = fn_oid;
+	pipeline->read_only = read_only;
+
+	pipeline->release_cb.func = pipeline_release_statements;
+	pipeline->release_cb.arg = pipeline;
+	MemoryContextRegisterResetCallback(cxt, &pipeline->release_cb);
+
+	return pipeline;
+}
+
+/*
+ * Adds the query to pipeline and returns its number. The values
+ * are not copied, they should be valid until execution. The nulls
+ * array can be NULL, when there are not null values.
+ */
+int
+simple_pipeline_queue(SimplePipeline *pipeline, const char *query,
+					  int nargs, Oid *argtypes,
+					  Datum *values, bool *nulls)
+{
+	PipelineQuery *pq;
+
+	if (pipeline->executed)
+		elog(ERROR, "pipeline was executed already");
+
+	if (pipeline->nqueries >= pipeline->maxqueries)
+	{
+		if (pipeline->maxqueries == 0)
+		{
+			pipeline->maxqueries = 16;
+			pipeline->queries = MemoryContextAlloc(pipeline->cxt,
+												   sizeof(PipelineQuery) * pipeline->maxqueries);
+		}
+		else
+		{
+			pipeline->maxqueries *= 2;
+			pipeline->queries = repalloc(pipeline->queries,
+										 sizeof(PipelineQuery) * pipeline->maxqueries);
+		}
+	}
+
+	pq = &pipeline->queries[pipeline->nqueries];
+
+	pq->stmt = get_pipeline_statement(query, nargs, argtypes);
+	pq->stmt->refcount += 1;
+	pq->values = values;
+	pq->nulls = NULL;
+	pq->result = (Datum) 0;
+	pq->isnull = true;
+
+	/* SPI uses char array for nulls */
+	if (nulls)
+	{
+		pq->nulls = MemoryContextAlloc(pipeline->cxt, nargs);
+		for (int i = 0; i < nargs; i++)
+			pq->nulls[i] = nulls[i] ? 'n' : ' ';
+	}
+
+	return pipeline->nqueries++;
+}
+
+/*
+ * Executes all queued queries. The results are copied to memory
+ * context of pipeline.
+ */
+void
+simple_pipeline_execute(SimplePipeline *pipeline)
+{
+	Snapshot	snapshot = InvalidSnapshot;
+	MemoryContext exec_cxt;
+	ExprContext *econtext;
+	MemoryContext oldcxt;
+	instr_time	spi_time;
+	int64		spi_executions = 0;
+	int64		spi_rows = 0;
+	uint64		exec_id;
+	List	   *cplans = NIL;
+	ListCell   *lc;
+
+	if (pipeline->executed)
+		elog(ERROR, "pipeline was executed already");
+
+	pipeline->executed = true;
+
+	if (pipeline->nqueries == 0)
+		return;
+
+	/*
+	 * States of simple expressions from previous (or nested) executions
+	 * are not valid. The id is local, because the global counter can be
+	 * increased by nested execution.
+	 */
+	exec_id = ++pipeline_exec_id;
+
+	exec_cxt = AllocSetContextCreate(pipeline->cxt,
+									 "simple pipeline execution",
+									 ALLOCSET_DEFAULT_SIZES);
+
+	oldcxt = MemoryContextSwitchTo(exec_cxt);
+	econtext = CreateStandaloneExprContext();
+	MemoryContextSwitchTo(oldcxt);
+
+	INSTR_TIME_SET_ZERO(spi_time);
+
+	SPI_connect();
+
+	for (int i = 0; i < pipeline->nqueries; i++)
+	{
+		PipelineQuery *pq = &pipeline->queries[i];
+		PipelineStatement *stmt = pq->stmt;
+		instr_time	start;
+		instr_time	end;
+		int			res;
+
+		if (!stmt->plan)
+		{
+			SPIPlanPtr	plan;
+
+			plan = SPI_prepare(stmt->key.query, stmt->key.nargs,
+							   (Oid *) stmt->key.argtypes);
+			if (!plan)
+				elog(ERROR, "SPI_prepare failed: %s",
+					 SPI_result_code_string(SPI_result));
+
+			SPI_keepplan(plan);
+			stmt->plan = plan;
+			stmt->is_simple = is_simple_query(plan);
+		}
+
+		if (pipeline_fast_path && stmt->is_simple &&
+			simple_expr_init(stmt, exec_id, exec_cxt, &cplans))
+		{
+			Datum		value;
+			bool		isnull;
+
+			for (int j = 0; j < stmt->key.nargs; j++)
+			{
+				stmt->params->params[j].value = pq->values[j];
+				stmt->params->params[j].isnull = pq->nulls && pq->nulls[j] == 'n';
+			}
+
+			econtext->ecxt_param_list_info = stmt->params;
+
+			ResetExprContext(econtext);
+			value = ExecEvalExprSwitchContext(stmt->exprstate, econtext, &isnull);
+
+			if (!isnull)
+			{
+				oldcxt = MemoryContextSwitchTo(pipeline->cxt);
+				pq->result = datumCopy(value, stmt->typbyval, stmt->typlen);
+				MemoryContextSwitchTo(oldcxt);
+			}
+
+			pq->isnull = isnull;
+
+			continue;
+		}
+
+		/*
+		 * Read only queries use active snapshot of caller. Other
+		 * queries use one snapshot (not new snapshot for any query).
+		 * AFTER triggers (and RI checks) of any query are fired at
+		 * end of the query, like for queries executed one by one.
+		 */
+		if (!pipeline->read_only && snapshot == InvalidSnapshot)
+			snapshot = RegisterSnapshot(GetLatestSnapshot());
+
+		INSTR_TIME_SET_CURRENT(start);
+		pgstat_report_wait_start(simple_spi_wait_event());
+
+		if (pipeline->read_only)
+			res = SPI_execute_plan(stmt->plan, pq->values, pq->nulls,
+								   true, 1);
+		else
+			res = SPI_execute_snapshot(stmt->plan, pq->values, pq->nulls,
+									   snapshot, InvalidSnapshot,
+									   false, true, 1);
+
+		pgstat_report_wait_end();
+		INSTR_TIME_SET_CURRENT(end);
+		INSTR_TIME_ACCUM_DIFF(spi_time, end, start);
+
+		if (res < 0)
+			elog(ERROR, "SPI_execute_plan failed: %s",
+				 SPI_result_code_string(res));
+
+		spi_executions += 1;
+		spi_rows += SPI_processed;
+
+		if (SPI_tuptable && SPI_processed > 0)
+		{
+			TupleDesc	tupdesc = SPI_tuptable->tupdesc;
+			Datum		value;
+			bool		isnull;
+
+			value = SPI_getbinval(SPI_tuptable->vals[0], tupdesc, 1, &isnull);
+
+			if (!isnull)
+			{
+				Form_pg_attribute attr = TupleDescAttr(tupdesc, 0);
+				MemoryContext oldcxt;
+
+				oldcxt = MemoryContextSwitchTo(pipeline->cxt);
+				pq->result = datumCopy(value, attr->attbyval, attr->attlen);
+				MemoryContextSwitchTo(oldcxt);
+			}
+
+			pq->isnull = isnull;
+		}
+
+		if (SPI_tuptable)
+			SPI_freetuptable(SPI_tuptable);
+	}
+
+	if (snapshot != InvalidSnapshot)
+		UnregisterSnapshot(snapshot);
+
+	/* release plans used by simple expressions of this execution */
+	foreach(lc, cplans)
+		ReleaseCachedPlan((CachedPlan *) lfirst(lc), CurrentResourceOwner);
+
+	for (int i = 0; i < pipeline->nqueries; i++)
+	{
+		PipelineStatement *stmt = pipeline->queries[i].stmt;
+
+		if (stmt->exec_id == exec_id)
+			stmt->exprstate = NULL;
+	}
+
+	SPI_finish();
+
+	simple_spi_stats_report(pipeline->fn_oid, spi_executions, spi_rows, spi_time);
+
+	FreeExprContext(econtext, true);
+	MemoryContextDelete(exec_cxt);
+}
+
+Datum
+simple_pipeline_result(SimplePipeline *pipeline, int n, bool *isnull)
+{
+	if (!pipeline->executed)
+		elog(ERROR, "pipeline was not executed");
+
+	if (n < 0 || n >= pipeline->nqueries)
+		elog(ERROR, "query %d is not in pipeline", n);
+
+	*isnull = pipeline->queries[n].isnull;
+
+	return pipeline->queries[n].result;
+}
+
+void
+simple_pipeline_free(SimplePipeline *pipeline)
+{
+	MemoryContextDelete(pipeline->cxt);
+}
+
+/*
+ * Same result like text_func, but for all fields of array, and the
+ * queries are executed by pipeline. The suffix (in database encoding)
+ * is passed as parameter, it is not a literal in UTF8 source code.
+ */
+Datum
+text_func_batch(PG_FUNCTION_ARGS)
+{
+	ArrayType  *arr = PG_GETARG_ARRAYTYPE_P(0);
+	SimplePipeline *pipeline;
+	Datum	   *elems;
+	bool	   *nulls;
+	Datum	   *results;
+	bool	   *rnulls;
+	int			nelems;
+	int		   *qids;
+	Datum	   *args;
+	Datum		suffix;
+	const char *suffix_str;
+	int			suffix_len;
+	Oid			argtypes[2] = {TEXTOID, TEXTOID};
+	int			ndims = ARR_NDIM(arr);
+	int			dims[MAXDIM];
+	int			lbs[MAXDIM];
+
+	deconstruct_array_builtin(arr, TEXTOID, &elems, &nulls, &nelems);
+
+	results = palloc(sizeof(Datum) * nelems);
+	rnulls = palloc(sizeof(bool) * nelems);
+	qids = palloc(sizeof(int) * nelems);
+
+	/* the values should be valid until the pipeline is executed */
+	args = palloc(sizeof(Datum) * 2 * nelems);
+
+	suffix_str = get_text_func_suffix(&suffix_len);
+	suffix = PointerGetDatum(cstring_to_text_with_len(suffix_str, suffix_len));
+
+	pipeline = simple_pipeline_create(fcinfo->flinfo->fn_oid, true);
+
+	for (int i = 0; i < nelems; i++)
+	{
+		if (nulls[i])
+			qids[i] = -1;
+		else
+		{
+			args[2 * i] = elems[i];
+			args[2 * i + 1] = suffix;
+
+			qids[i] = simple_pipeline_queue(pipeline,
+											"SELECT ($1 || $2)::text",
+											2, argtypes, &args[2 * i], NULL);
+		}
+	}
+
+	simple_pipeline_execute(pipeline);
+
+	for (int i = 0; i < nelems; i++)
+	{
+		if (qids[i] >= 0)
+		{
+			Datum		value;
+
+			value = simple_pipeline_result(pipeline, qids[i], &rnulls[i]);
+			results[i] = rnulls[i] ? (Datum) 0 : datumCopy(value, false, -1);
+		}
+		else
+		{
+			results[i] = (Datum) 0;
+			rnulls[i] = true;
+		}
+	}
+
+	simple_pipeline_free(pipeline);
+
+	if (ndims > 0)
+	{
+		memcpy(dims, ARR_DIMS(arr), sizeof(int) * ndims);
+		memcpy(lbs, ARR_LBOUND(arr), sizeof(int) * ndims);
+	}
+
+	PG_RETURN_ARRAYTYPE_P(construct_md_array(results, rnulls, ndims, dims, lbs,
+											 TEXTOID, -1, false, TYPALIGN_INT));
+}
+
+void
+simple_spi_pipeline_init(void)
+{
+	DefineCustomBoolVariable("simple.pipeline_fast_path",
+							 "Evaluates immutable queries without tables in SPI pipeline directly.",
+							 NULL,
+							 &pipeline_fast_path,
+							 true,
+							 PGC_USERSET,
+							 0,
+							 NULL, NULL, NULL);
+}
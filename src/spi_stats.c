@@ -0,0 +1,183 @@
+/*-------------------------------------------------------------------------
+ *
+ * simple
+ *	  simple demo extension - cumulative statistics of SPI execution
+ *
+ * Author:	Pavel Stehule
+ * Postcardware licence @2024
+ *
+ * IDENTIFICATION
+ *	  spi_stats.c
+ *
+ * The functions that execute queries by SPI (SPI pipeline, simple_copy_out)
+ * count executions, processed rows and time per function. The counters
+ * are stored by cumulative statistics system (custom statistics kind,
+ * PostgreSQL 18 and higher), so they are saved to file at shutdown
+ * like other statistics, and they are visible in view simple_spi_stats.
+ *
+ * The custom kind can be registered only when the library is loaded by
+ * shared_preload_libraries. Elsewhere nothing is counted. The counters
+ * are accumulated in pending entry, and they are flushed to shared
+ * memory by pgstat (usually at the end of transaction).
+ *
+ * The kind uses id PGSTAT_KIND_EXPERIMENTAL. Extensions used in
+ * production should reserve own id on PostgreSQL wiki.
+ *
+ *-------------------------------------------------------------------------
+ */
+
+#include "postgres.h"
+
+#include "access/htup_details.h"
+#include "funcapi.h"
+#include "miscadmin.h"
+#include "utils/builtins.h"
+
+#if PG_VERSION_NUM >= 180000
+#include "utils/pgstat_internal.h"
+#endif
+
+#include "simple.h"
+
+PG_FUNCTION_INFO_V1(simple_spi_stats);
+PG_FUNCTION_INFO_V1(simple_spi_stats_reset);
+
+#if PG_VERSION_NUM >= 180000
+
+#define PGSTAT_KIND_SIMPLE_SPI		PGSTAT_KIND_EXPERIMENTAL
+
+typedef struct SpiStatsCounts
+{
+	PgStat_Counter executions;
+	PgStat_Counter rows;
+	PgStat_Counter total_time;	/* in microseconds */
+} SpiStatsCounts;
+
+typedef struct PgStatShared_SimpleSpi
+{
+	PgStatShared_Common header;
+	SpiStatsCounts stats;
+} PgStatShared_SimpleSpi;
+
+static bool spi_stats_flush_pending(PgStat_EntryRef *entry_ref, bool nowait);
+
+static const PgStat_KindInfo spi_stats_kind_info = {
+	.name = "simple_spi",
+	.fixed_amount = false,
+	.write_to_file = true,
+	.shared_size = sizeof(PgStatShared_SimpleSpi),
+	.shared_data_off = offsetof(PgStatShared_SimpleSpi, stats),
+	.shared_data_len = sizeof(((PgStatShared_SimpleSpi *) 0)->stats),
+	.pending_size = sizeof(SpiStatsCounts),
+	.flush_pending_cb = spi_stats_flush_pending,
+};
+
+#endif
+
+/* true, when the statistics kind is registered */
+static bool spi_stats_enabled = false;
+
+#if PG_VERSION_NUM >= 180000
+
+static bool
+spi_stats_flush_pending(PgStat_EntryRef *entry_ref, bool nowait)
+{
+	SpiStatsCounts *pending = (SpiStatsCounts *) entry_ref->pending;
+	PgStatShared_SimpleSpi *shared = (PgStatShared_SimpleSpi *) entry_ref->shared_stats;
+
+	if (!pgstat_lock_entry(entry_ref, nowait))
+		return false;
+
+	shared->stats.executions += pending->executions;
+	shared->stats.rows += pending->rows;
+	shared->stats.total_time += pending->total_time;
+
+	pgstat_unlock_entry(entry_ref);
+
+	return true;
+}
+
+#endif
+
+/*
+ * Adds executions, rows and time of SPI execution of function fn_oid
+ * to pending statistics.
+ */
+void
+simple_spi_stats_report(Oid fn_oid, int64 executions, int64 rows,
+						instr_time time)
+{
+#if PG_VERSION_NUM >= 180000
+	PgStat_EntryRef *entry_ref;
+	SpiStatsCounts *pending;
+
+	if (!spi_stats_enabled || !OidIsValid(fn_oid))
+		return;
+
+	entry_ref = pgstat_prep_pending_entry(PGSTAT_KIND_SIMPLE_SPI,
+										  MyDatabaseId, fn_oid, NULL);
+	pending = (SpiStatsCounts *) entry_ref->pending;
+
+	pending->executions += executions;
+	pending->rows += rows;
+	pending->total_time += INSTR_TIME_GET_MICROSEC(time);
+#endif
+}
+
+/*
+ * Returns statistics of function funcid. Returns NULL, when there are
+ * not statistics.
+ */
+Datum
+simple_spi_stats(PG_FUNCTION_ARGS)
+{
+#if PG_VERSION_NUM >= 180000
+	Oid			fn_oid = PG_GETARG_OID(0);
+	SpiStatsCounts *stats;
+	TupleDesc	tupdesc;
+	Datum		values[3];
+	bool		nulls[3] = {0};
+
+	if (!spi_stats_enabled)
+		PG_RETURN_NULL();
+
+	stats = (SpiStatsCounts *) pgstat_fetch_entry(PGSTAT_KIND_SIMPLE_SPI,
+												  MyDatabaseId, fn_oid);
+	if (!stats)
+		PG_RETURN_NULL();
+
+	if (get_call_result_type(fcinfo, NULL, &tupdesc) != TYPEFUNC_COMPOSITE)
+		elog(ERROR, "return type must be a row type");
+
+	values[0] = Int64GetDatum(stats->executions);
+	values[1] = Int64GetDatum(stats->rows);
+	values[2] = Float8GetDatum((double) stats->total_time / 1000.0);
+
+	PG_RETURN_DATUM(HeapTupleGetDatum(heap_form_tuple(tupdesc, values, nulls)));
+#else
+	PG_RETURN_NULL();
+#endif
+}
+
+Datum
+simple_spi_stats_reset(PG_FUNCTION_ARGS)
+{
+#if PG_VERSION_NUM >= 180000
+	if (spi_stats_enabled)
+		pgstat_reset_of_kind(PGSTAT_KIND_SIMPLE_SPI);
+#endif
+
+	PG_RETURN_VOID();
+}
+
+void
+simple_spi_stats_init(void)
+{
+#if PG_VERSION_NUM >= 180000
+	if (!process_shared_preload_libraries_in_progress)
+		return;
+
+	pgstat_register_kind(PGSTAT_KIND_SIMPLE_SPI, &spi_stats_kind_info);
+	spi_stats_enabled = true;
+#endif
+}
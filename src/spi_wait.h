@@ -0,0 +1,57 @@
+/*-------------------------------------------------------------------------
+ *
+ * simple
+ *	  simple demo extension - wait event of SPI execution
+ *
+ * Author:	Pavel Stehule
+ * Postcardware licence @2024
+ *
+ * IDENTIFICATION
+ *	  spi_wait.h
+ *
+ * When a function executes queries by SPI, pg_stat_activity shows only
+ * the outer query. When the SPI call is surrounded by
+ *
+ *     pgstat_report_wait_start(simple_spi_wait_event());
+ *     res = SPI_execute_with_args(...);
+ *     pgstat_report_wait_end();
+ *
+ * then the backend is visible with wait event "SimpleSPIExecute" (type
+ * Extension) on PostgreSQL 17 and higher, and "Extension" on older
+ * releases. Attention - the wait event is not a stack. When the query
+ * waits for something else (lock, IO), then this wait event is replaced,
+ * and it is cleaned after end of this wait. So sampling shows the time
+ * of SPI only partially (usually the CPU time of query).
+ *
+ * The wait event is cleaned by abort of (sub)transaction after an error.
+ *
+ * This header file has not any dependency on simple.so, so it is used
+ * by lessons too.
+ *
+ *-------------------------------------------------------------------------
+ */
+#ifndef SIMPLE_SPI_WAIT_H
+#define SIMPLE_SPI_WAIT_H
+
+#include "utils/wait_event.h"
+
+/*
+ * Returns wait event of SPI execution. The custom wait event is
+ * registered by name, so all modules use the same wait event.
+ */
+static inline uint32
+simple_spi_wait_event(void)
+{
+#if PG_VERSION_NUM >= 170000
+	static uint32 wait_event_info = 0;
+
+	if (wait_event_info == 0)
+		wait_event_info = WaitEventExtensionNew("SimpleSPIExecute");
+
+	return wait_event_info;
+#else
+	return PG_WAIT_EXTENSION;
+#endif
+}
+
+#endif							/* SIMPLE_SPI_WAIT_H */
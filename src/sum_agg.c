@@ -0,0 +1,178 @@
+/*-------------------------------------------------------------------------
+ *
+ * simple
+ *	  simple demo extension - aggregate simple_sum with moving mode
+ *
+ * Author:	Pavel Stehule
+ * Postcardware licence @2024
+ *
+ * IDENTIFICATION
+ *	  sum_agg.c
+ *
+ * When the frame of window function is moving (ROWS BETWEEN n PRECEDING
+ * AND CURRENT ROW), then the executor has to compute the aggregate over
+ * all rows of frame for any row, when the aggregate has not inverse
+ * transition function. With inverse function (minvfunc) the row that
+ * leaves the frame is removed from the state, so the cost per row is
+ * O(1) instead O(frame).
+ *
+ *     SELECT simple_sum(int_func(x)) OVER (ORDER BY x ROWS BETWEEN 1000
+ *                                                 PRECEDING AND CURRENT ROW)
+ *       FROM tab;
+ *
+ * The state is int8[] array {count, sum} (like builtin avg(int)). The
+ * count is necessary for NULL result of frame with only NULL values.
+ * When the function is called as aggregate, the state is modified in
+ * place. The sum is 64-bit integer with overflow check (builtin sum
+ * of bigint uses numeric). simple_sum can be used in parallel query
+ * (combinefunc).
+ *
+ *-------------------------------------------------------------------------
+ */
+
+#include "postgres.h"
+
+#include "catalog/pg_type.h"
+#include "common/int.h"
+#include "utils/array.h"
+#include "utils/builtins.h"
+
+#include "simple.h"
+
+PG_FUNCTION_INFO_V1(simple_sum_accum_int4);
+PG_FUNCTION_INFO_V1(simple_sum_accum_int4_inv);
+PG_FUNCTION_INFO_V1(simple_sum_accum_int8);
+PG_FUNCTION_INFO_V1(simple_sum_accum_int8_inv);
+PG_FUNCTION_INFO_V1(simple_sum_combine);
+PG_FUNCTION_INFO_V1(simple_sum_final);
+
+typedef struct SumTransData
+{
+	int64		count;
+	int64		sum;
+} SumTransData;
+
+/*
+ * Returns the state. The aggregate's state can be modified in place,
+ * else it is copied.
+ */
+static ArrayType *
+get_sum_state(FunctionCallInfo fcinfo, int argno, SumTransData **transdata)
+{
+	ArrayType  *transarray;
+
+	if (AggCheckCallContext(fcinfo, NULL))
+		transarray = PG_GETARG_ARRAYTYPE_P(argno);
+	else
+		transarray = PG_GETARG_ARRAYTYPE_P_COPY(argno);
+
+	if (ARR_HASNULL(transarray) ||
+		ARR_SIZE(transarray) != ARR_OVERHEAD_NONULLS(1) + sizeof(SumTransData))
+		elog(ERROR, "expected 2-element int8 array");
+
+	*transdata = (SumTransData *) ARR_DATA_PTR(transarray);
+
+	return transarray;
+}
+
+static void
+sum_add(SumTransData *transdata, int64 value, int64 count)
+{
+	if (unlikely(pg_add_s64_overflow(transdata->sum, value, &transdata->sum)))
+		ereport(ERROR,
+				(errcode(ERRCODE_NUMERIC_VALUE_OUT_OF_RANGE),
+				 errmsg("bigint out of range")));
+
+	transdata->count += count;
+}
+
+static void
+sum_sub(SumTransData *transdata, int64 value)
+{
+	if (unlikely(pg_sub_s64_overflow(transdata->sum, value, &transdata->sum)))
+		ereport(ERROR,
+				(errcode(ERRCODE_NUMERIC_VALUE_OUT_OF_RANGE),
+				 errmsg("bigint out of range")));
+
+	transdata->count -= 1;
+}
+
+Datum
+simple_sum_accum_int4(PG_FUNCTION_ARGS)
+{
+	SumTransData *transdata;
+	ArrayType  *transarray = get_sum_state(fcinfo, 0, &transdata);
+
+	sum_add(transdata, (int64) PG_GETARG_INT32(1), 1);
+
+	PG_RETURN_ARRAYTYPE_P(transarray);
+}
+
+Datum
+simple_sum_accum_int4_inv(PG_FUNCTION_ARGS)
+{
+	SumTransData *transdata;
+	ArrayType  *transarray = get_sum_state(fcinfo, 0, &transdata);
+
+	sum_sub(transdata, (int64) PG_GETARG_INT32(1));
+
+	PG_RETURN_ARRAYTYPE_P(transarray);
+}
+
+Datum
+simple_sum_accum_int8(PG_FUNCTION_ARGS)
+{
+	SumTransData *transdata;
+	ArrayType  *transarray = get_sum_state(fcinfo, 0, &transdata);
+
+	sum_add(transdata, PG_GETARG_INT64(1), 1);
+
+	PG_RETURN_ARRAYTYPE_P(transarray);
+}
+
+Datum
+simple_sum_accum_int8_inv(PG_FUNCTION_ARGS)
+{
+	SumTransData *transdata;
+	ArrayType  *transarray = get_sum_state(fcinfo, 0, &transdata);
+
+	sum_sub(transdata, PG_GETARG_INT64(1));
+
+	PG_RETURN_ARRAYTYPE_P(transarray);
+}
+
+/*
+ * Merges states of parallel workers
+ */
+Datum
+simple_sum_combine(PG_FUNCTION_ARGS)
+{
+	SumTransData *transdata1;
+	SumTransData *transdata2;
+	ArrayType  *transarray1 = get_sum_state(fcinfo, 0, &transdata1);
+
+	(void) get_sum_state(fcinfo, 1, &transdata2);
+
+	sum_add(transdata1, transdata2->sum, transdata2->count);
+
+	PG_RETURN_ARRAYTYPE_P(transarray1);
+}
+
+Datum
+simple_sum_final(PG_FUNCTION_ARGS)
+{
+	ArrayType  *transarray = PG_GETARG_ARRAYTYPE_P(0);
+	SumTransData *transdata;
+
+	if (ARR_HASNULL(transarray) ||
+		ARR_SIZE(transarray) != ARR_OVERHEAD_NONULLS(1) + sizeof(SumTransData))
+		elog(ERROR, "expected 2-element int8 array");
+
+	transdata = (SumTransData *) ARR_DATA_PTR(transarray);
+
+	/* SQL defines sum of no non-null rows as NULL */
+	if (transdata->count == 0)
+		PG_RETURN_NULL();
+
+	PG_RETURN_INT64(transdata->sum);
+}
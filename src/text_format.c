@@ -0,0 +1,416 @@
+/*-------------------------------------------------------------------------
+ *
+ * simple
+ *	  simple demo extension - formatting by precompiled template
+ *
+ * Author:	Pavel Stehule
+ * Postcardware licence @2024
+ *
+ * IDENTIFICATION
+ *	  text_format.c
+ *
+ * text_format_fast(template, VARIADIC "any") is like format() with
+ * %s only:
+ *
+ *     %s      next argument
+ *     %n$s    n-th argument (next argument is n+1)
+ *     %%      percent sign
+ *
+ * NULL is formatted as empty string. The template is parsed once, the
+ * parsed template (segments of literals and arguments) is stored in
+ * fn_extra, and it is used for all rows (the template is only compared
+ * with cached template, that is much cheaper than parsing). The size of
+ * result is known before formatting, so the result is allocated by one
+ * palloc.
+ *
+ *-------------------------------------------------------------------------
+ */
+
+#include "postgres.h"
+#include "varatt.h"
+
+#include "catalog/pg_type.h"
+#include "funcapi.h"
+#include "utils/builtins.h"
+#include "utils/lsyscache.h"
+#include "utils/memutils.h"
+
+#include "scratch.h"
+#include "simple.h"
+
+PG_FUNCTION_INFO_V1(text_format_fast);
+
+typedef enum FormatArgKind
+{
+	FORMAT_ARG_TEXT,			/* text, varchar, bpchar - used directly */
+	FORMAT_ARG_CSTRING,			/* unknown literal */
+	FORMAT_ARG_OTHER			/* output function is used */
+} FormatArgKind;
+
+typedef struct FormatSegment
+{
+	int			argno;			/* -1 for literal */
+	int			offset;			/* position of literal in template */
+	int			len;			/* length of literal */
+} FormatSegment;
+
+typedef struct FormatCache
+{
+	MemoryContext cxt;			/* holds the cache and all its data */
+
+	char	   *template;		/* copy of parsed template */
+	int			template_len;
+
+	int			nsegments;
+	FormatSegment *segments;
+	int			literals_len;	/* length of all literals */
+
+	int			nargs;
+	Oid		   *argtypes;
+	FormatArgKind *argkinds;
+	FmgrInfo   *outfuncs;
+
+	/* string values of arguments of current row */
+	const char **argstrs;
+	int		   *arglens;
+
+	MemoryContext scratch;		/* detoasted values and output of functions,
+								 * child of cxt */
+} FormatCache;
+
+/*
+ * Parses template to segments. The segments array is allocated
+ * with upper bound size (the template has maximally len / 2 + 1
+ * literals and len / 2 arguments).
+ */
+static void
+parse_template(FormatCache *cache)
+{
+	const char *tmpl = cache->template;
+	int			len = cache->template_len;
+	int			next_arg = 0;
+	int			literal_start = 0;
+	int			i = 0;
+
+	cache->segments = palloc(sizeof(FormatSegment) * (len + 1));
+	cache->nsegments = 0;
+	cache->literals_len = 0;
+
+#define ADD_LITERAL(start, end) \
+	do { \
+		if ((end) > (start)) \
+		{ \
+			FormatSegment *seg = &cache->segments[cache->nsegments++]; \
+			seg->argno = -1; \
+			seg->offset = (start); \
+			seg->len = (end) - (start); \
+			cache->literals_len += seg->len; \
+		} \
+	} while (0)
+
+	while (i < len)
+	{
+		int			argno;
+		FormatSegment *seg;
+
+		if (tmpl[i] != '%')
+		{
+			i++;
+			continue;
+		}
+
+		ADD_LITERAL(literal_start, i);
+
+		if (++i >= len)
+			ereport(ERROR,
+					(errcode(ERRCODE_INVALID_PARAMETER_VALUE),
+					 errmsg("unterminated format() type specifier")));
+
+		if (tmpl[i] == '%')
+		{
+			/* percent sign is literal started by second % */
+			literal_start = i++;
+			continue;
+		}
+
+		if (tmpl[i] >= '1' && tmpl[i] <= '9')
+		{
+			int			n = 0;
+
+			while (i < len && tmpl[i] >= '0' && tmpl[i] <= '9')
+			{
+				n = n * 10 + (tmpl[i++] - '0');
+
+				if (n > cache->nargs)
+					ereport(ERROR,
+							(errcode(ERRCODE_INVALID_PARAMETER_VALUE),
+							 errmsg("too few arguments for format()")));
+			}
+
+			if (i >= len || tmpl[i] != '$')
+				ereport(ERROR,
+						(errcode(ERRCODE_INVALID_PARAMETER_VALUE),
+						 errmsg("unsupported format() specifier"),
+						 errhint("Only %%s, %%n$s and %%%% are supported.")));
+
+			i++;
+			argno = n - 1;
+		}
+		else
+			argno = next_arg;
+
+		if (i >= len || tmpl[i] != 's')
+			ereport(ERROR,
+					(errcode(ERRCODE_INVALID_PARAMETER_VALUE),
+					 errmsg("unsupported format() specifier"),
+					 errhint("Only %%s, %%n$s and %%%% are supported.")));
+
+		if (argno >= cache->nargs)
+			ereport(ERROR,
+					(errcode(ERRCODE_INVALID_PARAMETER_VALUE),
+					 errmsg("too few arguments for format()")));
+
+		seg = &cache->segments[cache->nsegments++];
+		seg->argno = argno;
+		seg->offset = 0;
+		seg->len = 0;
+
+		next_arg = argno + 1;
+		literal_start = ++i;
+	}
+
+	ADD_LITERAL(literal_start, len);
+
+#undef ADD_LITERAL
+}
+
+/*
+ * Returns cached parsed template. It is parsed again, when the
+ * template or types of arguments are changed. Any cache has own memory
+ * context, so the old cache is released by one delete (the template
+ * can be different for any row).
+ */
+static FormatCache *
+get_format_cache(FunctionCallInfo fcinfo, text *template,
+				 int nargs, Oid *argtypes)
+{
+	FmgrInfo   *flinfo = fcinfo->flinfo;
+	FormatCache *cache = (FormatCache *) flinfo->fn_extra;
+	const char *tmpl = VARDATA_ANY(template);
+	int			len = VARSIZE_ANY_EXHDR(template);
+	MemoryContext cxt;
+	MemoryContext oldcxt;
+
+	if (cache)
+	{
+		bool		valid = cache->nargs == nargs;
+
+		if (valid && nargs > 0)
+			valid = memcmp(cache->argtypes, argtypes, sizeof(Oid) * nargs) == 0;
+
+		if (valid)
+			valid = cache->template_len == len &&
+				memcmp(cache->template, tmpl, len) == 0;
+
+		if (valid)
+			return cache;
+
+		flinfo->fn_extra = NULL;
+		MemoryContextDelete(cache->cxt);
+	}
+
+	cxt = AllocSetContextCreate(flinfo->fn_mcxt,
+								"text_format_fast cache",
+								ALLOCSET_SMALL_SIZES);
+
+	oldcxt = MemoryContextSwitchTo(cxt);
+
+	cache = palloc0(sizeof(FormatCache));
+	cache->cxt = cxt;
+
+	cache->template = palloc(len + 1);
+	memcpy(cache->template, tmpl, len);
+	cache->template[len] = '\0';
+	cache->template_len = len;
+
+	cache->nargs = nargs;
+	cache->argtypes = palloc(sizeof(Oid) * (nargs + 1));
+	cache->argkinds = palloc(sizeof(FormatArgKind) * (nargs + 1));
+	cache->outfuncs = palloc0(sizeof(FmgrInfo) * (nargs + 1));
+	cache->argstrs = palloc(sizeof(char *) * (nargs + 1));
+	cache->arglens = palloc(sizeof(int) * (nargs + 1));
+
+	for (int i = 0; i < nargs; i++)
+	{
+		Oid			typid = argtypes[i];
+
+		cache->argtypes[i] = typid;
+
+		if (typid == TEXTOID || typid == VARCHAROID || typid == BPCHAROID)
+			cache->argkinds[i] = FORMAT_ARG_TEXT;
+		else if (typid == UNKNOWNOID)
+			cache->argkinds[i] = FORMAT_ARG_CSTRING;
+		else
+		{
+			Oid			typoutput;
+			bool		typisvarlena;
+
+			getTypeOutputInfo(typid, &typoutput, &typisvarlena);
+			fmgr_info_cxt(typoutput, &cache->outfuncs[i], cxt);
+
+			cache->argkinds[i] = FORMAT_ARG_OTHER;
+		}
+	}
+
+	parse_template(cache);
+
+	MemoryContextSwitchTo(oldcxt);
+
+	flinfo->fn_extra = cache;
+
+	return cache;
+}
+
+Datum
+text_format_fast(PG_FUNCTION_ARGS)
+{
+	FmgrInfo   *flinfo = fcinfo->flinfo;
+	FormatCache *cache;
+	text	   *template;
+	text	   *result;
+	Datum	   *args;
+	Oid		   *argtypes;
+	bool	   *argnulls;
+	Oid			argtypes_buf[FUNC_MAX_ARGS];
+	int			nargs;
+	int			len;
+	char	   *ptr;
+	MemoryContext oldcxt;
+
+	if (PG_ARGISNULL(0))
+		PG_RETURN_NULL();
+
+	if (!flinfo || !flinfo->fn_expr)
+		elog(ERROR, "could not determine data type of text_format_fast() input");
+
+	/*
+	 * Usually the arguments are passed directly, but with VARIADIC
+	 * keyword they are passed in an array.
+	 */
+	if (get_fn_expr_variadic(flinfo))
+	{
+		nargs = extract_variadic_args(fcinfo, 1, true,
+									  &args, &argtypes, &argnulls);
+
+		/* VARIADIC NULL is same like no arguments */
+		if (nargs < 0)
+			nargs = 0;
+	}
+	else
+	{
+		nargs = PG_NARGS() - 1;
+
+		for (int i = 0; i < nargs; i++)
+		{
+			argtypes_buf[i] = get_fn_expr_argtype(flinfo, i + 1);
+
+			if (!OidIsValid(argtypes_buf[i]))
+				elog(ERROR, "could not determine data type of text_format_fast() input");
+		}
+
+		argtypes = argtypes_buf;
+		args = NULL;
+		argnulls = NULL;
+	}
+
+	template = PG_GETARG_TEXT_PP(0);
+
+	cache = get_format_cache(fcinfo, template, nargs, argtypes);
+
+	/* memory used by conversions of arguments is released on next call */
+	oldcxt = MemoryContextSwitchTo(scratch_context_reset(&cache->scratch,
+														 cache->cxt));
+
+	len = cache->literals_len;
+
+	for (int i = 0; i < nargs; i++)
+	{
+		Datum		value;
+		bool		isnull;
+
+		if (args)
+		{
+			value = args[i];
+			isnull = argnulls[i];
+		}
+		else
+		{
+			value = PG_GETARG_DATUM(i + 1);
+			isnull = PG_ARGISNULL(i + 1);
+		}
+
+		if (isnull)
+		{
+			cache->argstrs[i] = NULL;
+			cache->arglens[i] = 0;
+			continue;
+		}
+
+		switch (cache->argkinds[i])
+		{
+			case FORMAT_ARG_TEXT:
+				{
+					text	   *t = (text *) pg_detoast_datum_packed((struct varlena *) DatumGetPointer(value));
+
+					cache->argstrs[i] = VARDATA_ANY(t);
+					cache->arglens[i] = VARSIZE_ANY_EXHDR(t);
+				}
+				break;
+
+			case FORMAT_ARG_CSTRING:
+				cache->argstrs[i] = DatumGetCString(value);
+				cache->arglens[i] = strlen(cache->argstrs[i]);
+				break;
+
+			case FORMAT_ARG_OTHER:
+				cache->argstrs[i] = OutputFunctionCall(&cache->outfuncs[i], value);
+				cache->arglens[i] = strlen(cache->argstrs[i]);
+				break;
+		}
+	}
+
+	MemoryContextSwitchTo(oldcxt);
+
+	for (int i = 0; i < cache->nsegments; i++)
+	{
+		if (cache->segments[i].argno >= 0)
+			len += cache->arglens[cache->segments[i].argno];
+	}
+
+	result = (text *) palloc(len + VARHDRSZ);
+	SET_VARSIZE(result, len + VARHDRSZ);
+
+	ptr = VARDATA(result);
+
+	for (int i = 0; i < cache->nsegments; i++)
+	{
+		FormatSegment *seg = &cache->segments[i];
+
+		if (seg->argno >= 0)
+		{
+			int			arglen = cache->arglens[seg->argno];
+
+			if (arglen > 0)
+				memcpy(ptr, cache->argstrs[seg->argno], arglen);
+
+			ptr += arglen;
+		}
+		else
+		{
+			memcpy(ptr, cache->template + seg->offset, seg->len);
+			ptr += seg->len;
+		}
+	}
+
+	PG_RETURN_TEXT_P(result);
+}
@@ -0,0 +1,474 @@
+/*-------------------------------------------------------------------------
+ *
+ * simple
+ *	  simple demo extension - text_func evaluated by background workers
+ *
+ * Author:	Pavel Stehule
+ * Postcardware licence @2024
+ *
+ * IDENTIFICATION
+ *	  text_func_parallel.c
+ *
+ * text_func_parallel(text[], workers) evaluates text_func for all fields
+ * of array by dynamic background workers. It can be used when parallel
+ * query cannot be used (for example inside PL/pgSQL).
+ *
+ * The leader serializes input to dynamic shared memory (DSM), and any
+ * worker processes its own continuous slice of fields. The results are
+ * sent back by shared memory queue (shm_mq) - one queue per worker. The
+ * leader reads all queues (without waiting on one queue) and stores the
+ * results to their positions, so the order of fields is same like in
+ * input array.
+ *
+ *     message:  'N'            NULL
+ *               'V', bytes     value
+ *
+ * The workers are not connected to database, so the suffix (in database
+ * encoding) is passed by DSM too. When the leader fails, the DSM segment
+ * is detached, and the workers stop when they try to send next message.
+ *
+ * When there are not free slots for background workers (max_worker_processes),
+ * then the slices of workers that cannot be registered are processed by
+ * the leader (in the worst case the leader processes all fields).
+ *
+ *-------------------------------------------------------------------------
+ */
+
+#include "postgres.h"
+#include "varatt.h"
+
+#include "catalog/pg_type.h"
+#include "miscadmin.h"
+#include "postmaster/bgworker.h"
+#include "storage/dsm.h"
+#include "storage/ipc.h"
+#include "storage/latch.h"
+#include "storage/proc.h"
+#include "storage/shm_mq.h"
+#include "storage/shm_toc.h"
+#include "tcop/tcopprot.h"
+#include "utils/array.h"
+#include "utils/memutils.h"
+#include "utils/resowner.h"
+#include "utils/wait_event.h"
+
+#include "simple.h"
+
+PG_FUNCTION_INFO_V1(text_func_parallel);
+
+PGDLLEXPORT void text_func_parallel_worker(Datum main_arg);
+
+#define TEXT_FUNC_PARALLEL_MAGIC		2024101521
+
+#define TEXT_FUNC_PARALLEL_MAX_WORKERS	64
+#define TEXT_FUNC_PARALLEL_QUEUE_SIZE	(1024 * 1024)
+
+/* keys of shm_toc */
+#define KEY_SHARED		1
+#define KEY_SUFFIX		2
+#define KEY_INPUT		3
+#define KEY_QUEUE		4			/* KEY_QUEUE + worker number */
+
+typedef struct TextFuncSlice
+{
+	int64		first;			/* index of first field */
+	int64		nitems;
+	Size		offset;			/* position of first field in input */
+} TextFuncSlice;
+
+typedef struct TextFuncParallelShared
+{
+	int			nworkers;
+	int			suffix_len;
+	TextFuncSlice slices[FLEXIBLE_ARRAY_MEMBER];
+} TextFuncParallelShared;
+
+/*
+ * Writes fields of array to input chunk (int32 length, -1 is NULL,
+ * and bytes), and sets offsets of slices.
+ */
+static void
+serialize_input(ArrayType *arr, char *input, TextFuncParallelShared *shared)
+{
+	ArrayIterator iterator;
+	Datum		value;
+	bool		isnull;
+	char	   *ptr = input;
+	int64		idx = 0;
+	int			w = 0;
+
+	iterator = array_create_iterator(arr, 0, NULL);
+
+	while (array_iterate(iterator, &value, &isnull))
+	{
+		int32		len;
+
+		if (w < shared->nworkers && idx == shared->slices[w].first)
+			shared->slices[w++].offset = ptr - input;
+
+		if (isnull)
+		{
+			len = -1;
+			memcpy(ptr, &len, sizeof(int32));
+			ptr += sizeof(int32);
+		}
+		else
+		{
+			text	   *t = (text *) pg_detoast_datum_packed((struct varlena *) DatumGetPointer(value));
+
+			len = VARSIZE_ANY_EXHDR(t);
+			memcpy(ptr, &len, sizeof(int32));
+			ptr += sizeof(int32);
+			memcpy(ptr, VARDATA_ANY(t), len);
+			ptr += len;
+		}
+
+		idx += 1;
+	}
+
+	array_free_iterator(iterator);
+}
+
+/*
+ * Processes the slice in leader, when the worker cannot be registered
+ */
+static void
+process_slice(TextFuncSlice *slice, const char *input,
+			  const char *suffix, int suffix_len,
+			  Datum *results, bool *nulls)
+{
+	const char *ptr = input + slice->offset;
+
+	for (int64 i = 0; i < slice->nitems; i++)
+	{
+		int64		idx = slice->first + i;
+		int32		len;
+
+		memcpy(&len, ptr, sizeof(int32));
+		ptr += sizeof(int32);
+
+		if (len < 0)
+		{
+			results[idx] = (Datum) 0;
+			nulls[idx] = true;
+		}
+		else
+		{
+			results[idx] = PointerGetDatum(text_func_concat(ptr, len,
+															suffix, suffix_len));
+			nulls[idx] = false;
+			ptr += len;
+		}
+	}
+}
+
+Datum
+text_func_parallel(PG_FUNCTION_ARGS)
+{
+	ArrayType  *arr = PG_GETARG_ARRAYTYPE_P(0);
+	int			workers = PG_GETARG_INT32(1);
+	int64		nitems;
+	int			nworkers;
+	int			nstarted;
+	const char *suffix;
+	int			suffix_len;
+	Size		input_size;
+	Size		shared_size;
+	shm_toc_estimator e;
+	dsm_segment *seg;
+	shm_toc    *toc;
+	TextFuncParallelShared *shared;
+	shm_mq_handle **mqhs;
+	int64	   *received;
+	Datum	   *results;
+	bool	   *nulls;
+	int			remaining;
+	int64		first = 0;
+	char	   *input;
+	char	   *ptr;
+
+	if (workers < 1 || workers > TEXT_FUNC_PARALLEL_MAX_WORKERS)
+		ereport(ERROR,
+				(errcode(ERRCODE_INVALID_PARAMETER_VALUE),
+				 errmsg("number of workers must be between 1 and %d",
+						TEXT_FUNC_PARALLEL_MAX_WORKERS)));
+
+	nitems = ArrayGetNItems(ARR_NDIM(arr), ARR_DIMS(arr));
+	if (nitems == 0)
+		PG_RETURN_ARRAYTYPE_P(arr);
+
+	nworkers = (int) Min(workers, nitems);
+
+	suffix = get_text_func_suffix(&suffix_len);
+
+	/* upper bound - the length (int32) of any field is added to array */
+	input_size = add_size(ARR_SIZE(arr), mul_size(nitems, sizeof(int32)));
+	shared_size = add_size(offsetof(TextFuncParallelShared, slices),
+						   mul_size(nworkers, sizeof(TextFuncSlice)));
+
+	shm_toc_initialize_estimator(&e);
+	shm_toc_estimate_chunk(&e, shared_size);
+	shm_toc_estimate_chunk(&e, suffix_len);
+	shm_toc_estimate_chunk(&e, input_size);
+	for (int i = 0; i < nworkers; i++)
+		shm_toc_estimate_chunk(&e, TEXT_FUNC_PARALLEL_QUEUE_SIZE);
+	shm_toc_estimate_keys(&e, 3 + nworkers);
+
+	seg = dsm_create(shm_toc_estimate(&e), 0);
+	toc = shm_toc_create(TEXT_FUNC_PARALLEL_MAGIC,
+						 dsm_segment_address(seg),
+						 shm_toc_estimate(&e));
+
+	shared = shm_toc_allocate(toc, shared_size);
+	shared->nworkers = nworkers;
+	shared->suffix_len = suffix_len;
+
+	/* continuous slices of similar size */
+	for (int i = 0; i < nworkers; i++)
+	{
+		shared->slices[i].first = first;
+		shared->slices[i].nitems = nitems / nworkers + (i < nitems % nworkers ? 1 : 0);
+		first += shared->slices[i].nitems;
+	}
+
+	shm_toc_insert(toc, KEY_SHARED, shared);
+
+	ptr = shm_toc_allocate(toc, suffix_len);
+	memcpy(ptr, suffix, suffix_len);
+	shm_toc_insert(toc, KEY_SUFFIX, ptr);
+
+	input = shm_toc_allocate(toc, input_size);
+	serialize_input(arr, input, shared);
+	shm_toc_insert(toc, KEY_INPUT, input);
+
+	mqhs = palloc(sizeof(shm_mq_handle *) * nworkers);
+	received = palloc0(sizeof(int64) * nworkers);
+
+	results = palloc(sizeof(Datum) * nitems);
+	nulls = palloc(sizeof(bool) * nitems);
+
+	nstarted = nworkers;
+
+	for (int i = 0; i < nworkers; i++)
+	{
+		BackgroundWorker worker;
+		BackgroundWorkerHandle *handle;
+		shm_mq	   *mq;
+
+		mq = shm_mq_create(shm_toc_allocate(toc, TEXT_FUNC_PARALLEL_QUEUE_SIZE),
+						   TEXT_FUNC_PARALLEL_QUEUE_SIZE);
+		shm_toc_insert(toc, KEY_QUEUE + i, mq);
+		shm_mq_set_receiver(mq, MyProc);
+
+		memset(&worker, 0, sizeof(worker));
+		worker.bgw_flags = BGWORKER_SHMEM_ACCESS;
+		worker.bgw_start_time = BgWorkerStart_ConsistentState;
+		worker.bgw_restart_time = BGW_NEVER_RESTART;
+		snprintf(worker.bgw_library_name, BGW_MAXLEN, "simple");
+		snprintf(worker.bgw_function_name, BGW_MAXLEN, "text_func_parallel_worker");
+		snprintf(worker.bgw_name, BGW_MAXLEN, "simple text_func_parallel worker %d", i);
+		snprintf(worker.bgw_type, BGW_MAXLEN, "simple text_func_parallel");
+		worker.bgw_main_arg = UInt32GetDatum(dsm_segment_handle(seg));
+		worker.bgw_notify_pid = MyProcPid;
+		memcpy(worker.bgw_extra, &i, sizeof(int));
+
+		if (!RegisterDynamicBackgroundWorker(&worker, &handle))
+		{
+			elog(DEBUG1, "text_func_parallel started %d of %d workers",
+				 i, nworkers);
+
+			nstarted = i;
+			break;
+		}
+
+		/* the receiving fails when the worker is not started */
+		mqhs[i] = shm_mq_attach(mq, seg, handle);
+	}
+
+	/* the slices without worker are processed when workers are running */
+	for (int i = nstarted; i < nworkers; i++)
+	{
+		process_slice(&shared->slices[i], input, suffix, suffix_len,
+					  results, nulls);
+
+		CHECK_FOR_INTERRUPTS();
+	}
+
+	remaining = nstarted;
+
+	while (remaining > 0)
+	{
+		bool		progress = false;
+
+		for (int i = 0; i < nstarted; i++)
+		{
+			TextFuncSlice *slice = &shared->slices[i];
+
+			while (received[i] < slice->nitems)
+			{
+				int64		idx = slice->first + received[i];
+				shm_mq_result res;
+				Size		nbytes;
+				void	   *data;
+				char	   *msg;
+
+				res = shm_mq_receive(mqhs[i], &nbytes, &data, true);
+
+				if (res == SHM_MQ_WOULD_BLOCK)
+					break;
+
+				if (res != SHM_MQ_SUCCESS)
+					ereport(ERROR,
+							(errcode(ERRCODE_OBJECT_NOT_IN_PREREQUISITE_STATE),
+							 errmsg("background worker of text_func_parallel exited before sending all results")));
+
+				msg = (char *) data;
+
+				if (nbytes < 1 || (msg[0] != 'N' && msg[0] != 'V'))
+					elog(ERROR, "unexpected message from background worker of text_func_parallel");
+
+				if (msg[0] == 'N')
+				{
+					results[idx] = (Datum) 0;
+					nulls[idx] = true;
+				}
+				else
+				{
+					text	   *t = (text *) palloc(nbytes - 1 + VARHDRSZ);
+
+					memcpy(VARDATA(t), msg + 1, nbytes - 1);
+					SET_VARSIZE(t, nbytes - 1 + VARHDRSZ);
+
+					results[idx] = PointerGetDatum(t);
+					nulls[idx] = false;
+				}
+
+				if (++received[i] == slice->nitems)
+					remaining -= 1;
+
+				progress = true;
+			}
+		}
+
+		if (!progress)
+		{
+			(void) WaitLatch(MyLatch,
+							 WL_LATCH_SET | WL_EXIT_ON_PM_DEATH,
+							 0,
+							 PG_WAIT_EXTENSION);
+			ResetLatch(MyLatch);
+		}
+
+		CHECK_FOR_INTERRUPTS();
+	}
+
+	for (int i = 0; i < nstarted; i++)
+		shm_mq_detach(mqhs[i]);
+
+	dsm_detach(seg);
+
+	PG_RETURN_ARRAYTYPE_P(construct_md_array(results, nulls,
+											 ARR_NDIM(arr),
+											 ARR_DIMS(arr),
+											 ARR_LBOUND(arr),
+											 TEXTOID, -1, false, TYPALIGN_INT));
+}
+
+/*
+ * Entry point of background worker
+ */
+void
+text_func_parallel_worker(Datum main_arg)
+{
+	dsm_segment *seg;
+	shm_toc    *toc;
+	TextFuncParallelShared *shared;
+	TextFuncSlice *slice;
+	const char *suffix;
+	char	   *ptr;
+	shm_mq	   *mq;
+	shm_mq_handle *mqh;
+	MemoryContext cxt;
+	int			worker_number;
+
+	memcpy(&worker_number, MyBgworkerEntry->bgw_extra, sizeof(int));
+
+	pqsignal(SIGTERM, die);
+	BackgroundWorkerUnblockSignals();
+
+	/* dsm_attach requires resource owner */
+	CurrentResourceOwner = ResourceOwnerCreate(NULL, "simple text_func_parallel worker");
+
+	seg = dsm_attach(DatumGetUInt32(main_arg));
+	if (seg == NULL)
+		ereport(ERROR,
+				(errcode(ERRCODE_OBJECT_NOT_IN_PREREQUISITE_STATE),
+				 errmsg("could not map dynamic shared memory segment")));
+
+	toc = shm_toc_attach(TEXT_FUNC_PARALLEL_MAGIC, dsm_segment_address(seg));
+	if (toc == NULL)
+		ereport(ERROR,
+				(errcode(ERRCODE_OBJECT_NOT_IN_PREREQUISITE_STATE),
+				 errmsg("invalid magic number in dynamic shared memory segment")));
+
+	shared = shm_toc_lookup(toc, KEY_SHARED, false);
+	suffix = shm_toc_lookup(toc, KEY_SUFFIX, false);
+	ptr = shm_toc_lookup(toc, KEY_INPUT, false);
+	mq = shm_toc_lookup(toc, KEY_QUEUE + worker_number, false);
+
+	slice = &shared->slices[worker_number];
+	ptr += slice->offset;
+
+	shm_mq_set_sender(mq, MyProc);
+	mqh = shm_mq_attach(mq, seg, NULL);
+
+	cxt = AllocSetContextCreate(TopMemoryContext,
+								"text_func_parallel worker",
+								ALLOCSET_DEFAULT_SIZES);
+
+	for (int64 i = 0; i < slice->nitems; i++)
+	{
+		shm_mq_iovec iov[2];
+		shm_mq_result res;
+		int32		len;
+
+		memcpy(&len, ptr, sizeof(int32));
+		ptr += sizeof(int32);
+
+		if (len < 0)
+		{
+			iov[0].data = "N";
+			iov[0].len = 1;
+
+			res = shm_mq_sendv(mqh, iov, 1, false, false);
+		}
+		else
+		{
+			MemoryContext oldcxt = MemoryContextSwitchTo(cxt);
+			text	   *result;
+
+			result = text_func_concat(ptr, len, suffix, shared->suffix_len);
+			ptr += len;
+
+			iov[0].data = "V";
+			iov[0].len = 1;
+			iov[1].data = VARDATA(result);
+			iov[1].len = VARSIZE(result) - VARHDRSZ;
+
+			res = shm_mq_sendv(mqh, iov, 2, false, false);
+
+			MemoryContextSwitchTo(oldcxt);
+			MemoryContextReset(cxt);
+		}
+
+		/* the leader doesn't wait for results */
+		if (res != SHM_MQ_SUCCESS)
+			break;
+	}
+
+	/* sends data that are not flushed yet */
+	shm_mq_detach(mqh);
+	dsm_detach(seg);
+
+	proc_exit(0);
+}
@@ -0,0 +1,282 @@
+/*-------------------------------------------------------------------------
+ *
+ * simple
+ *	  simple demo extension - maintenance of text_func column by trigger
+ *
+ * Author:	Pavel Stehule
+ * Postcardware licence @2024
+ *
+ * IDENTIFICATION
+ *	  text_func_trigger.c
+ *
+ * The column with precomputed text_func(source) is usually maintained
+ * by row trigger, that evaluates text_func for every updated row. The
+ * statement trigger text_func_maintain(key, source, target) gets all
+ * changed rows in transition tables, and it updates the target column
+ * only for rows where the source column was changed (or the key was
+ * changed), and only by one UPDATE statement:
+ *
+ *     CREATE TRIGGER t_ins AFTER INSERT ON t
+ *       REFERENCING NEW TABLE AS new_rows
+ *       FOR EACH STATEMENT
+ *       EXECUTE FUNCTION text_func_maintain('id', 'name', 'name_text');
+ *
+ *     CREATE TRIGGER t_upd AFTER UPDATE ON t
+ *       REFERENCING OLD TABLE AS old_rows NEW TABLE AS new_rows
+ *       FOR EACH STATEMENT
+ *       EXECUTE FUNCTION text_func_maintain('id', 'name', 'name_text');
+ *
+ * The key column should be unique. The old and new rows are matched by
+ * the key, so when the key column is updated (the keys can be swapped
+ * by one statement with deferrable unique constraint), the old row can
+ * be other row, and then the target is recomputed for all updated rows.
+ *
+ * The plans of UPDATE statements are saved per trigger (like PL/pgSQL
+ * does), and they are used by next executions of trigger. The UPDATE
+ * executed by trigger fires the same trigger again, so the nested call
+ * for same table does nothing.
+ *
+ *-------------------------------------------------------------------------
+ */
+
+#include "postgres.h"
+
+#include "access/sysattr.h"
+#include "commands/extension.h"
+#include "commands/trigger.h"
+#include "executor/spi.h"
+#include "nodes/bitmapset.h"
+#include "utils/builtins.h"
+#include "utils/hsearch.h"
+#include "utils/lsyscache.h"
+#include "utils/memutils.h"
+#include "utils/rel.h"
+
+#include "simple.h"
+
+PG_FUNCTION_INFO_V1(text_func_maintain);
+
+typedef struct MaintainPlanKey
+{
+	Oid			tgoid;
+	bool		compare_old;
+} MaintainPlanKey;
+
+typedef struct MaintainPlan
+{
+	MaintainPlanKey key;		/* hash key */
+	char	   *query;
+	SPIPlanPtr	plan;
+} MaintainPlan;
+
+static HTAB *maintain_plans = NULL;
+
+/* tables updated by active text_func_maintain */
+static List *active_relids = NIL;
+
+/*
+ * Builds the UPDATE statement. The transition table of old rows is
+ * used only for UPDATE, when the key is not updated.
+ */
+static char *
+maintain_query(TriggerData *trigdata, bool compare_old)
+{
+	Trigger    *trigger = trigdata->tg_trigger;
+	Relation	rel = trigdata->tg_relation;
+	const char *key = quote_identifier(trigger->tgargs[0]);
+	const char *source = quote_identifier(trigger->tgargs[1]);
+	const char *target = quote_identifier(trigger->tgargs[2]);
+	char	   *relname;
+	char	   *funcname;
+	StringInfoData str;
+
+	relname = quote_qualified_identifier(get_namespace_name(RelationGetNamespace(rel)),
+										 RelationGetRelationName(rel));
+
+	/* the extension is relocatable, so the function is qualified */
+	funcname = quote_qualified_identifier(get_namespace_name(get_extension_schema(get_extension_oid("simple", false))),
+										  "text_func");
+
+	initStringInfo(&str);
+
+	appendStringInfo(&str, "UPDATE %s t SET %s = %s(n.%s) FROM %s n",
+					 relname, target, funcname, source,
+					 quote_identifier(trigger->tgnewtable));
+
+	if (compare_old)
+		appendStringInfo(&str,
+						 " LEFT JOIN %s o ON o.%s = n.%s"
+						 " WHERE t.%s = n.%s"
+						 " AND (o.%s IS NULL OR o.%s IS DISTINCT FROM n.%s)",
+						 quote_identifier(trigger->tgoldtable), key, key,
+						 key, key,
+						 key, source, source);
+	else
+		appendStringInfo(&str, " WHERE t.%s = n.%s", key, key);
+
+	return str.data;
+}
+
+/*
+ * Returns the saved plan. The plan is prepared again when the query
+ * is different (the table was renamed).
+ */
+static SPIPlanPtr
+maintain_plan(TriggerData *trigdata, bool compare_old)
+{
+	MaintainPlanKey key;
+	MaintainPlan *entry;
+	char	   *query;
+	bool		found;
+
+	if (!maintain_plans)
+	{
+		HASHCTL		ctl;
+
+		ctl.keysize = sizeof(MaintainPlanKey);
+		ctl.entrysize = sizeof(MaintainPlan);
+		ctl.hcxt = TopMemoryContext;
+
+		maintain_plans = hash_create("simple text_func_maintain plans",
+									 16,
+									 &ctl,
+									 HASH_ELEM | HASH_BLOBS | HASH_CONTEXT);
+	}
+
+	query = maintain_query(trigdata, compare_old);
+
+	memset(&key, 0, sizeof(key));
+	key.tgoid = trigdata->tg_trigger->tgoid;
+	key.compare_old = compare_old;
+
+	entry = hash_search(maintain_plans, &key, HASH_ENTER, &found);
+	if (!found)
+	{
+		entry->query = NULL;
+		entry->plan = NULL;
+	}
+
+	if (!entry->plan || strcmp(entry->query, query) != 0)
+	{
+		SPIPlanPtr	plan;
+
+		if (entry->plan)
+		{
+			SPI_freeplan(entry->plan);
+			pfree(entry->query);
+			entry->plan = NULL;
+		}
+
+		plan = SPI_prepare(query, 0, NULL);
+		if (!plan)
+			elog(ERROR, "SPI_prepare failed: %s",
+				 SPI_result_code_string(SPI_result));
+
+		SPI_keepplan(plan);
+
+		entry->query = MemoryContextStrdup(TopMemoryContext, query);
+		entry->plan = plan;
+	}
+
+	return entry->plan;
+}
+
+Datum
+text_func_maintain(PG_FUNCTION_ARGS)
+{
+	TriggerData *trigdata = (TriggerData *) fcinfo->context;
+	Trigger    *trigger;
+	TupleDesc	tupdesc;
+	AttrNumber	attnums[3];
+	Oid			relid;
+	bool		is_update;
+	bool		compare_old;
+	MemoryContext oldcxt;
+
+	if (!CALLED_AS_TRIGGER(fcinfo))
+		ereport(ERROR,
+				(errcode(ERRCODE_E_R_I_E_TRIGGER_PROTOCOL_VIOLATED),
+				 errmsg("text_func_maintain: not called by trigger manager")));
+
+	if (!TRIGGER_FIRED_AFTER(trigdata->tg_event) ||
+		!TRIGGER_FIRED_FOR_STATEMENT(trigdata->tg_event))
+		ereport(ERROR,
+				(errcode(ERRCODE_E_R_I_E_TRIGGER_PROTOCOL_VIOLATED),
+				 errmsg("text_func_maintain must be fired AFTER for each statement")));
+
+	if (TRIGGER_FIRED_BY_UPDATE(trigdata->tg_event))
+		is_update = true;
+	else if (TRIGGER_FIRED_BY_INSERT(trigdata->tg_event))
+		is_update = false;
+	else
+		ereport(ERROR,
+				(errcode(ERRCODE_E_R_I_E_TRIGGER_PROTOCOL_VIOLATED),
+				 errmsg("text_func_maintain must be fired for INSERT or UPDATE")));
+
+	trigger = trigdata->tg_trigger;
+
+	if (trigger->tgnargs != 3)
+		ereport(ERROR,
+				(errcode(ERRCODE_INVALID_PARAMETER_VALUE),
+				 errmsg("text_func_maintain requires three arguments"),
+				 errhint("The arguments are names of key, source and target columns.")));
+
+	if (!trigger->tgnewtable || (is_update && !trigger->tgoldtable))
+		ereport(ERROR,
+				(errcode(ERRCODE_E_R_I_E_TRIGGER_PROTOCOL_VIOLATED),
+				 errmsg("text_func_maintain requires transition tables"),
+				 errhint("Use REFERENCING NEW TABLE AS ... (and OLD TABLE AS ... for UPDATE).")));
+
+	tupdesc = RelationGetDescr(trigdata->tg_relation);
+
+	for (int i = 0; i < 3; i++)
+	{
+		attnums[i] = SPI_fnumber(tupdesc, trigger->tgargs[i]);
+		if (attnums[i] <= 0)
+			ereport(ERROR,
+					(errcode(ERRCODE_UNDEFINED_COLUMN),
+					 errmsg("column \"%s\" of relation \"%s\" does not exist",
+							trigger->tgargs[i],
+							RelationGetRelationName(trigdata->tg_relation))));
+	}
+
+	/* with updated key the old row with same key can be other row */
+	compare_old = is_update &&
+		!bms_is_member(attnums[0] - FirstLowInvalidHeapAttributeNumber,
+					   trigdata->tg_updatedcols);
+
+	relid = RelationGetRelid(trigdata->tg_relation);
+
+	/* nested call from own UPDATE */
+	if (list_member_oid(active_relids, relid))
+		return PointerGetDatum(NULL);
+
+	SPI_connect();
+
+	if (SPI_register_trigger_data(trigdata) != SPI_OK_TD_REGISTER)
+		elog(ERROR, "SPI_register_trigger_data failed");
+
+	oldcxt = MemoryContextSwitchTo(TopMemoryContext);
+	active_relids = lappend_oid(active_relids, relid);
+	MemoryContextSwitchTo(oldcxt);
+
+	PG_TRY();
+	{
+		int			res;
+
+		res = SPI_execute_plan(maintain_plan(trigdata, compare_old),
+							   NULL, NULL, false, 0);
+		if (res != SPI_OK_UPDATE)
+			elog(ERROR, "SPI_execute_plan failed: %s",
+				 SPI_result_code_string(res));
+	}
+	PG_FINALLY();
+	{
+		active_relids = list_delete_last(active_relids);
+	}
+	PG_END_TRY();
+
+	SPI_finish();
+
+	return PointerGetDatum(NULL);
+}
@@ -0,0 +1,319 @@
+/*-------------------------------------------------------------------------
+ *
+ * simple
+ *	  simple demo extension - tracing of function calls to ring buffer
+ *
+ * Author:	Pavel Stehule
+ * Postcardware licence @2024
+ *
+ * IDENTIFICATION
+ *	  trace.c
+ *
+ * The lesson simple_10.c traces calls by elog(NOTICE). It is nice for
+ * demonstration, but it is unusable under load (every message is sent
+ * to client). When simple.trace_calls is on, the fmgr hook (fmgr_hook.c)
+ * writes fixed size events to ring buffer in shared memory, and the
+ * events can be read by simple_trace_read(). Writing of an event is
+ * only one atomic increment and a few stores - there are not locks.
+ *
+ * Any backend can write (multiple producers). The writer gets position
+ * by pg_atomic_fetch_add_u64 on head. The slot is owned by position
+ * modulo size of buffer. The sequence number of slot is cleaned before
+ * writing, and it is set to position + 1 after writing (with write
+ * barrier). The reader copies the slot and checks the sequence number
+ * before and after copying (like seqlock). Old events are overwritten,
+ * and the reader skips events that are overwritten or not finished.
+ *
+ * The buffer is allocated in shared memory when the library is loaded
+ * by shared_preload_libraries. Elsewhere (PostgreSQL 17 and higher) it
+ * is allocated by the DSM registry when it is used first time.
+ *
+ * The events can be saved to file by COPY or simple_copy_out:
+ *
+ *     SELECT simple_copy_out('SELECT * FROM simple_trace_read()', '/tmp/trace');
+ *
+ *-------------------------------------------------------------------------
+ */
+
+#include "postgres.h"
+
+#include "funcapi.h"
+#include "miscadmin.h"
+#include "port/atomics.h"
+#include "port/pg_bitutils.h"
+#include "storage/ipc.h"
+#include "storage/lwlock.h"
+#include "storage/shmem.h"
+#include "utils/builtins.h"
+#include "utils/guc.h"
+#include "utils/timestamp.h"
+
+#if PG_VERSION_NUM >= 170000
+#include "storage/dsm_registry.h"
+#endif
+
+#include "simple.h"
+
+PG_FUNCTION_INFO_V1(simple_trace_read);
+
+typedef struct TraceEvent
+{
+	pg_atomic_uint64 seq;		/* position + 1, 0 when slot is written */
+	TimestampTz ts;
+	int32		pid;
+	Oid			fn_oid;
+	int32		event;			/* FmgrHookEventType */
+} TraceEvent;
+
+typedef struct TraceBuffer
+{
+	uint32		size;			/* power of 2 */
+	pg_atomic_uint64 head;		/* position of next event */
+	TraceEvent	events[FLEXIBLE_ARRAY_MEMBER];
+} TraceBuffer;
+
+bool		simple_trace_calls = false;
+
+static int	trace_buffer_size = 65536;
+
+/* true, when the library is loaded by shared_preload_libraries */
+static bool trace_preloaded = false;
+
+static TraceBuffer *trace_buffer = NULL;
+
+static shmem_request_hook_type prev_shmem_request_hook = NULL;
+static shmem_startup_hook_type prev_shmem_startup_hook = NULL;
+
+static uint32
+trace_buffer_nevents(void)
+{
+	return pg_nextpower2_32((uint32) trace_buffer_size);
+}
+
+static Size
+trace_buffer_shmem_size(void)
+{
+	return add_size(offsetof(TraceBuffer, events),
+					mul_size(trace_buffer_nevents(), sizeof(TraceEvent)));
+}
+
+static void
+trace_buffer_init(void *ptr)
+{
+	TraceBuffer *buffer = (TraceBuffer *) ptr;
+
+	buffer->size = trace_buffer_nevents();
+	pg_atomic_init_u64(&buffer->head, 0);
+
+	for (uint32 i = 0; i < buffer->size; i++)
+		pg_atomic_init_u64(&buffer->events[i].seq, 0);
+}
+
+static void
+trace_shmem_request(void)
+{
+	if (prev_shmem_request_hook)
+		prev_shmem_request_hook();
+
+	RequestAddinShmemSpace(trace_buffer_shmem_size());
+}
+
+static void
+trace_shmem_startup(void)
+{
+	bool		found;
+
+	if (prev_shmem_startup_hook)
+		prev_shmem_startup_hook();
+
+	LWLockAcquire(AddinShmemInitLock, LW_EXCLUSIVE);
+
+	trace_buffer = ShmemInitStruct("simple trace buffer",
+								   trace_buffer_shmem_size(),
+								   &found);
+	if (!found)
+		trace_buffer_init(trace_buffer);
+
+	LWLockRelease(AddinShmemInitLock);
+}
+
+static bool
+check_trace_calls(bool *newval, void **extra, GucSource source)
+{
+#if PG_VERSION_NUM < 170000
+	if (*newval && !trace_preloaded)
+	{
+		GUC_check_errdetail("\"simple\" must be loaded by \"shared_preload_libraries\".");
+		return false;
+	}
+#endif
+
+	return true;
+}
+
+/*
+ * Attaches the ring buffer. Without shared_preload_libraries the buffer
+ * is created by first backend that uses it.
+ */
+void
+simple_trace_attach(void)
+{
+	if (trace_buffer)
+		return;
+
+	if (trace_preloaded)
+		elog(ERROR, "trace buffer of \"simple\" is not initialized");
+
+#if PG_VERSION_NUM >= 170000
+	{
+		bool		found;
+
+		trace_buffer = GetNamedDSMSegment("simple trace buffer",
+										  trace_buffer_shmem_size(),
+										  trace_buffer_init,
+										  &found);
+	}
+#else
+	ereport(ERROR,
+			(errcode(ERRCODE_OBJECT_NOT_IN_PREREQUISITE_STATE),
+			 errmsg("trace buffer is not available"),
+			 errdetail("\"simple\" must be loaded by \"shared_preload_libraries\".")));
+#endif
+}
+
+/*
+ * Writes an event to ring buffer. It should be fast, so it does not
+ * raise errors - when the buffer is not attached, the event is lost.
+ */
+void
+simple_trace_event(Oid fn_oid, FmgrHookEventType event)
+{
+	uint64		pos;
+	TraceEvent *slot;
+
+	if (!trace_buffer)
+		return;
+
+	pos = pg_atomic_fetch_add_u64(&trace_buffer->head, 1);
+	slot = &trace_buffer->events[pos & (trace_buffer->size - 1)];
+
+	/* readers ignore the slot until it is completed */
+	pg_atomic_write_u64(&slot->seq, 0);
+	pg_write_barrier();
+
+	slot->ts = GetCurrentTimestamp();
+	slot->pid = MyProcPid;
+	slot->fn_oid = fn_oid;
+	slot->event = (int32) event;
+
+	pg_write_barrier();
+	pg_atomic_write_u64(&slot->seq, pos + 1);
+}
+
+static const char *
+trace_event_name(int32 event)
+{
+	switch ((FmgrHookEventType) event)
+	{
+		case FHET_START:
+			return "start";
+		case FHET_END:
+			return "end";
+		case FHET_ABORT:
+			return "abort";
+	}
+
+	return "unknown";
+}
+
+/*
+ * Returns events from ring buffer with position since or later.
+ */
+Datum
+simple_trace_read(PG_FUNCTION_ARGS)
+{
+	ReturnSetInfo *rsinfo = (ReturnSetInfo *) fcinfo->resultinfo;
+	int64		since = PG_GETARG_INT64(0);
+	uint64		head;
+	uint64		pos;
+
+	InitMaterializedSRF(fcinfo, 0);
+
+	simple_trace_attach();
+
+	head = pg_atomic_read_u64(&trace_buffer->head);
+
+	/* older events are overwritten already */
+	pos = head > trace_buffer->size ? head - trace_buffer->size : 0;
+	if (since > 0 && (uint64) since > pos)
+		pos = (uint64) since;
+
+	for (; pos < head; pos++)
+	{
+		TraceEvent *slot = &trace_buffer->events[pos & (trace_buffer->size - 1)];
+		TraceEvent	event;
+		Datum		values[5];
+		bool		nulls[5] = {0};
+
+		if (pg_atomic_read_u64(&slot->seq) != pos + 1)
+			continue;
+
+		pg_read_barrier();
+
+		event.ts = slot->ts;
+		event.pid = slot->pid;
+		event.fn_oid = slot->fn_oid;
+		event.event = slot->event;
+
+		pg_read_barrier();
+
+		/* the slot was overwritten during copying */
+		if (pg_atomic_read_u64(&slot->seq) != pos + 1)
+			continue;
+
+		values[0] = Int64GetDatum((int64) pos);
+		values[1] = Int32GetDatum(event.pid);
+		values[2] = ObjectIdGetDatum(event.fn_oid);
+		values[3] = CStringGetTextDatum(trace_event_name(event.event));
+		values[4] = TimestampTzGetDatum(event.ts);
+
+		tuplestore_putvalues(rsinfo->setResult, rsinfo->setDesc, values, nulls);
+	}
+
+	return (Datum) 0;
+}
+
+void
+simple_trace_init(void)
+{
+	trace_preloaded = process_shared_preload_libraries_in_progress;
+
+	DefineCustomBoolVariable("simple.trace_calls",
+							 "Writes calls of int_func and text_func to trace buffer.",
+							 NULL,
+							 &simple_trace_calls,
+							 false,
+							 PGC_SUSET,
+							 0,
+							 check_trace_calls, NULL, NULL);
+
+	DefineCustomIntVariable("simple.trace_buffer_size",
+							"Sets the number of events in trace buffer.",
+							"The value is rounded up to power of 2.",
+							&trace_buffer_size,
+							65536,
+							1024,
+							1024 * 1024 * 16,
+							PGC_POSTMASTER,
+							0,
+							NULL, NULL, NULL);
+
+	if (!trace_preloaded)
+		return;
+
+	prev_shmem_request_hook = shmem_request_hook;
+	shmem_request_hook = trace_shmem_request;
+
+	prev_shmem_startup_hook = shmem_startup_hook;
+	shmem_startup_hook = trace_shmem_startup;
+}
@@ -0,0 +1,34 @@
+LOAD 'simple';
+
+SET client_min_messages TO warning;
+
+SELECT simple_adaptive_stats_reset();
+
+-- calls with constants are evaluated by planner, and any call has own
+-- state (two measured calls)
+SELECT text_func_adaptive('Ahoj'), text_func_adaptive(''), text_func_adaptive(NULL) IS NULL AS "null";
+
+-- all strategies return same result
+SET simple.adaptive_strategy TO direct;
+SELECT text_func_adaptive('Ahoj');
+SET simple.adaptive_strategy TO fmgr;
+SELECT text_func_adaptive('Ahoj');
+SET simple.adaptive_strategy TO spi;
+SELECT text_func_adaptive('Ahoj');
+SELECT count(*) FROM generate_series(1, 10) g(i) WHERE text_func_adaptive('x' || i) = text_func('x' || i);
+
+SELECT strategy, samples, chosen, calls FROM simple_adaptive_stats();
+
+RESET simple.adaptive_strategy;
+
+SELECT simple_adaptive_stats_reset();
+
+-- first 6 calls are measured, then one strategy is chosen
+SET simple.adaptive_samples TO 6;
+
+SELECT count(*) FROM generate_series(1, 100) g(i) WHERE text_func_adaptive('x' || i) = text_func('x' || i);
+
+SELECT sum(samples) AS samples, sum(chosen) AS chosen, sum(calls) AS calls
+  FROM simple_adaptive_stats();
+
+RESET simple.adaptive_samples;
@@ -0,0 +1,41 @@
+-- the planner hook is active after loading of library
+LOAD 'simple';
+
+CREATE TABLE batch_tab(a int, b text);
+INSERT INTO batch_tab SELECT i, 'row ' || i FROM generate_series(1, 3000) g(i);
+INSERT INTO batch_tab VALUES (NULL, 'null'), (-10, 'zero');
+
+EXPLAIN (COSTS OFF) SELECT int_func(a), b FROM batch_tab;
+EXPLAIN (COSTS OFF) SELECT int_func(a), b FROM batch_tab WHERE a IS NULL OR a < 0 OR a > 2998;
+SELECT int_func(a), b FROM batch_tab WHERE a IS NULL OR a < 0 OR a > 2998;
+
+-- batch evaluation should to return same result like scalar evaluation
+CREATE TABLE batch_res AS SELECT int_func(a) AS r, b FROM batch_tab;
+
+SET simple.enable_batch_scan TO off;
+EXPLAIN (COSTS OFF) SELECT int_func(a), b FROM batch_tab;
+SELECT count(*) FROM (SELECT int_func(a), b FROM batch_tab EXCEPT ALL SELECT r, b FROM batch_res) s;
+SELECT count(*) FROM (SELECT r, b FROM batch_res EXCEPT ALL SELECT int_func(a), b FROM batch_tab) s;
+RESET simple.enable_batch_scan;
+
+-- overflow is detected by batch evaluation too
+INSERT INTO batch_tab VALUES (2147483647, 'max');
+SELECT int_func(a), b FROM batch_tab;
+SET simple.enable_batch_scan TO off;
+SELECT int_func(a), b FROM batch_tab;
+RESET simple.enable_batch_scan;
+
+-- rows before overflow are returned like by scalar evaluation
+CREATE TABLE batch_limit(a int);
+INSERT INTO batch_limit VALUES (1), (2), (3), (2147483647), (4);
+EXPLAIN (COSTS OFF) SELECT int_func(a) FROM batch_limit LIMIT 3;
+SELECT int_func(a) FROM batch_limit LIMIT 3;
+SELECT int_func(a) FROM batch_limit LIMIT 4;
+SET simple.enable_batch_scan TO off;
+SELECT int_func(a) FROM batch_limit LIMIT 3;
+SELECT int_func(a) FROM batch_limit LIMIT 4;
+RESET simple.enable_batch_scan;
+DROP TABLE batch_limit;
+
+DROP TABLE batch_res;
+DROP TABLE batch_tab;
@@ -0,0 +1,37 @@
+LOAD 'simple';
+
+SET client_min_messages TO warning;
+
+\getenv abs_builddir PG_ABS_BUILDDIR
+\set filename :abs_builddir '/results/copy_binary.data'
+
+CREATE TABLE copy_binary_src(a int, b text, c numeric, d int[]);
+INSERT INTO copy_binary_src
+  SELECT i, text_func('Ahoj ' || i), i / 3.0, ARRAY[i, int_func(i)]
+    FROM generate_series(1, 10000) g(i);
+INSERT INTO copy_binary_src VALUES(NULL, NULL, NULL, NULL);
+
+SELECT simple_copy_out('SELECT * FROM copy_binary_src', :'filename');
+
+CREATE TABLE copy_binary_dst(LIKE copy_binary_src);
+
+-- the file can be loaded by COPY
+COPY copy_binary_dst FROM :'filename' WITH (FORMAT binary);
+
+SELECT count(*) FROM (SELECT * FROM copy_binary_src EXCEPT ALL SELECT * FROM copy_binary_dst) s;
+
+TRUNCATE copy_binary_dst;
+
+-- or by loader
+SELECT simple_copy_in('copy_binary_dst', :'filename');
+
+SELECT count(*) FROM (SELECT * FROM copy_binary_src EXCEPT ALL SELECT * FROM copy_binary_dst) s;
+
+-- empty result
+SELECT simple_copy_out('SELECT * FROM copy_binary_src WHERE false', :'filename');
+SELECT simple_copy_in('copy_binary_dst', :'filename');
+
+-- errors
+SELECT simple_copy_out('SELECT 1', 'copy_binary.data');
+
+DROP TABLE copy_binary_src, copy_binary_dst;
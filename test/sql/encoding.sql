@@ -0,0 +1,28 @@
+--
+-- text_func returns the suffix in database encoding
+--
+\set orig_db :DBNAME
+
+CREATE DATABASE simple_latin2 ENCODING 'LATIN2' LC_COLLATE 'C' LC_CTYPE 'C' TEMPLATE template0;
+
+\c simple_latin2
+SET client_encoding TO UTF8;
+SET client_min_messages TO warning;
+
+CREATE EXTENSION simple;
+
+SELECT text_func('Příliš'), octet_length(text_func('Příliš'));
+SELECT text_func(''), octet_length(text_func(''));
+
+\c :orig_db
+SET client_min_messages TO warning;
+
+DROP DATABASE simple_latin2;
+
+-- the regression database can use other encoding than UTF8
+SELECT getdatabaseencoding() <> 'UTF8' AS skip_test \gset
+\if :skip_test
+\quit
+\endif
+
+SELECT text_func('Příliš'), octet_length(text_func('Příliš'));
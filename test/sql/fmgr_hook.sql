@@ -0,0 +1,18 @@
+-- the hooks are active after loading of library
+LOAD 'simple';
+
+SET client_min_messages TO warning;
+SET simple.track_memory TO on;
+
+SELECT sum(int_func(i)) FROM generate_series(1, 100) g(i);
+SELECT length(text_func(repeat('x', 100000)));
+
+-- the call contexts are released together with per tuple contexts
+SELECT funcid, calls, total_bytes > 100000 AS allocated, live_contexts, live_bytes
+  FROM simple_memory_stats()
+ ORDER BY funcid::text;
+
+SELECT simple_memory_stats_reset();
+SELECT count(*) FROM simple_memory_stats();
+
+RESET simple.track_memory;
@@ -0,0 +1,27 @@
+--
+-- The results should be same with and without JIT. When the server
+-- is not built with LLVM, the JIT settings are ignored.
+--
+SET client_min_messages TO warning;
+SET simple.enable_batch_scan TO off;
+
+CREATE TABLE jit_tab(i int, t text);
+INSERT INTO jit_tab SELECT i, 'row ' || i FROM generate_series(1, 10000) g(i);
+INSERT INTO jit_tab VALUES (NULL, NULL);
+
+SET jit TO off;
+SELECT sum(int_func(i)), count(int_func(i)), sum(length(text_func(t))) FROM jit_tab WHERE i IS NOT NULL;
+
+SET jit TO on;
+SET jit_above_cost TO 0;
+SET jit_optimize_above_cost TO 0;
+SET jit_inline_above_cost TO 0;
+SELECT sum(int_func(i)), count(int_func(i)), sum(length(text_func(t))) FROM jit_tab WHERE i IS NOT NULL;
+SELECT int_func(i) FROM jit_tab WHERE i IS NULL OR i < 3 ORDER BY 1;
+
+RESET jit;
+RESET jit_above_cost;
+RESET jit_optimize_above_cost;
+RESET jit_inline_above_cost;
+
+DROP TABLE jit_tab;
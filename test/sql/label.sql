@@ -0,0 +1,55 @@
+LOAD 'simple';
+
+SET client_min_messages TO warning;
+
+CREATE TABLE label_test(id int, l simple_label);
+
+-- the codes are assigned in order of insert
+INSERT INTO label_test VALUES (1, 'Nazdar'), (2, 'Ahoj'), (3, 'Nazdar'), (4, NULL);
+
+-- sorted by value, not by code
+SELECT id, pg_column_size(l) AS size, l FROM label_test ORDER BY l, id;
+
+-- one value has one code
+SELECT count(*) FROM simple_label_dict WHERE label IN ('Ahoj', 'Nazdar');
+
+SELECT 'Ahoj'::simple_label = 'Ahoj' AS eq, 'Ahoj'::simple_label <> 'Nazdar' AS ne,
+       'Ahoj'::simple_label < 'Nazdar' AS lt, 'Nazdar'::simple_label >= 'Ahoj' AS ge;
+
+-- results of text_func
+INSERT INTO label_test SELECT 10 + i, text_func('Ahoj') FROM generate_series(1, 3) g(i);
+
+SELECT l, count(*) FROM label_test GROUP BY l ORDER BY l;
+
+SET enable_mergejoin TO off;
+SET enable_nestloop TO off;
+
+SELECT count(*) FROM label_test a JOIN label_test b USING (l);
+
+RESET enable_mergejoin;
+RESET enable_nestloop;
+
+-- the code of rolled back label is not cached
+BEGIN;
+INSERT INTO label_test VALUES (20, 'rolled back');
+ROLLBACK;
+
+INSERT INTO label_test VALUES (20, 'rolled back');
+SELECT l::text FROM label_test WHERE id = 20;
+SELECT count(*) FROM simple_label_dict WHERE label = 'rolled back';
+
+-- change of dictionary resets the cache
+DELETE FROM label_test WHERE id = 20;
+DELETE FROM simple_label_dict WHERE label = 'rolled back';
+
+INSERT INTO label_test VALUES (20, 'rolled back');
+SELECT count(*) FROM simple_label_dict WHERE label = 'rolled back';
+
+-- restored rows of dictionary are not in conflict with inserted labels
+INSERT INTO simple_label_dict SELECT code, 'restored' FROM simple_label_dict WHERE label = 'Ahoj';
+INSERT INTO simple_label_dict SELECT code + 1000000, label FROM simple_label_dict WHERE label = 'Ahoj';
+SELECT label, count(*) FROM simple_label_dict WHERE label IN ('Ahoj', 'restored') GROUP BY label ORDER BY label;
+SELECT 'restored'::simple_label::text AS restored;
+DELETE FROM simple_label_dict WHERE label = 'restored';
+
+DROP TABLE label_test;
@@ -0,0 +1,28 @@
+--
+-- the fmgr hook of simple_10 searches int_func and text_func
+-- by name, so they should be unique in search_path
+--
+CREATE SCHEMA lesson_10;
+SET search_path TO lesson_10;
+
+CREATE FUNCTION int_func(int) RETURNS int AS '$libdir/simple_10', 'int_func' LANGUAGE C STRICT;
+
+-- text_func is not created yet, int_func is hooked
+SELECT int_func(10);
+
+CREATE FUNCTION text_func(text) RETURNS text AS '$libdir/simple_10', 'text_func' LANGUAGE C;
+
+SELECT text_func('Ahoj');
+SELECT text_func(NULL);
+
+SET client_min_messages TO warning;
+
+-- simple_10 doesn't check overflow
+SELECT int_func(2147483638);
+
+SELECT length(text_func(repeat('Příliš žluťoučký kůň ', 500000)));
+SELECT sum(length(text_func('row ' || i))) FROM generate_series(1, 10000) g(i);
+
+RESET search_path;
+
+DROP SCHEMA lesson_10 CASCADE;
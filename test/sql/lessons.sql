@@ -0,0 +1,92 @@
+--
+-- every lesson src/simple_N.c is installed as module simple_N
+--
+-- simple_3 returns a value from released memory (it is an example
+-- of bug), and simple_10 (fmgr hook) is tested by lesson_10.
+--
+SET client_min_messages TO warning;
+
+-- text_func of simple_0 and simple_1 doesn't handle NULL
+CREATE TABLE lessons(n int, strict_text_func bool);
+INSERT INTO lessons VALUES
+  (0, true), (1, true), (2, false), (4, false), (5, false), (6, false),
+  (7, false), (8, false), (9, false);
+
+DO $$
+DECLARE r record;
+BEGIN
+  FOR r IN SELECT * FROM lessons
+  LOOP
+    EXECUTE format('CREATE FUNCTION int_func_%s(int) RETURNS int AS %L, %L LANGUAGE C STRICT',
+                   r.n, '$libdir/simple_' || r.n, 'int_func');
+    EXECUTE format('CREATE FUNCTION text_func_%s(text) RETURNS text AS %L, %L LANGUAGE C %s',
+                   r.n, '$libdir/simple_' || r.n, 'text_func',
+                   CASE WHEN r.strict_text_func THEN 'STRICT' ELSE '' END);
+  END LOOP;
+END;
+$$;
+
+-- returns result of function of lesson n or error message
+CREATE FUNCTION pg_temp.lesson_call(func text, n int, arg anyelement)
+RETURNS text AS $$
+DECLARE r text;
+BEGIN
+  EXECUTE format('SELECT %s_%s($1)::text', func, n) INTO r USING arg;
+  RETURN r;
+EXCEPTION WHEN OTHERS THEN
+  RETURN 'ERROR: ' || sqlerrm;
+END;
+$$ LANGUAGE plpgsql;
+
+-- query should to use %1$s instead of lesson's number
+CREATE FUNCTION pg_temp.lesson_query(n int, query text)
+RETURNS text AS $$
+DECLARE r text;
+BEGIN
+  EXECUTE format(query, n) INTO r;
+  RETURN r;
+END;
+$$ LANGUAGE plpgsql;
+
+-- int_func (simple_0, simple_8 and simple_9 don't check overflow)
+SELECT n, pg_temp.lesson_call('int_func', n, 10) AS "10",
+       pg_temp.lesson_call('int_func', n, 2147483637) AS max,
+       pg_temp.lesson_call('int_func', n, 2147483638) AS overflow
+  FROM lessons ORDER BY n;
+
+-- text_func
+SELECT n, pg_temp.lesson_call('text_func', n, 'Ahoj'::text) AS ahoj,
+       pg_temp.lesson_call('text_func', n, ''::text) AS empty,
+       pg_temp.lesson_call('text_func', n, NULL::text) AS "null"
+  FROM lessons ORDER BY n;
+
+SELECT n, pg_temp.lesson_call('text_func', n, 'Příliš žluťoučký kůň'::text) AS multibyte
+  FROM lessons ORDER BY n;
+
+-- toasted (compressed and external) values
+CREATE TABLE lessons_toast(c text, e text);
+ALTER TABLE lessons_toast ALTER COLUMN e SET STORAGE EXTERNAL;
+INSERT INTO lessons_toast SELECT v, v FROM repeat('Příliš žluťoučký kůň ', 500000) v;
+
+SELECT n, pg_temp.lesson_query(n, 'SELECT length(text_func_%1$s(c)) - length(c) FROM lessons_toast') AS c_added,
+       pg_temp.lesson_query(n, 'SELECT length(text_func_%1$s(e)) - length(e) FROM lessons_toast') AS e_added
+  FROM lessons ORDER BY n;
+
+-- results copied from SPI memory context should be valid
+SELECT n, pg_temp.lesson_query(n, 'SELECT sum(length(text_func_%1$s(''row '' || i))) FROM generate_series(1, 10000) g(i)') AS sum
+  FROM lessons ORDER BY n;
+
+DROP TABLE lessons_toast;
+
+DO $$
+DECLARE r record;
+BEGIN
+  FOR r IN SELECT * FROM lessons
+  LOOP
+    EXECUTE format('DROP FUNCTION int_func_%s(int)', r.n);
+    EXECUTE format('DROP FUNCTION text_func_%s(text)', r.n);
+  END LOOP;
+END;
+$$;
+
+DROP TABLE lessons;
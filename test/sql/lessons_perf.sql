@@ -0,0 +1,54 @@
+--
+-- perf smoke test of lessons, the limits are very tolerant
+--
+-- It is not part of installcheck (the timing depends on load of
+-- machine), it is executed by make installcheck-perf.
+--
+SET client_min_messages TO warning;
+
+-- lessons simple_4 .. simple_7 execute SPI query per call
+CREATE TABLE lessons_perf(n int, int_func_limit interval, text_func_limit interval);
+INSERT INTO lessons_perf VALUES
+  (0, '2s', '2s'), (1, '2s', '2s'), (2, '2s', '2s'),
+  (4, '2s', '10s'), (5, '2s', '10s'), (6, '2s', '10s'), (7, '2s', '10s'),
+  (8, '2s', '2s'), (9, '2s', '2s');
+
+DO $$
+DECLARE r record;
+BEGIN
+  FOR r IN SELECT * FROM lessons_perf
+  LOOP
+    EXECUTE format('CREATE FUNCTION int_func_%s(int) RETURNS int AS %L, %L LANGUAGE C STRICT',
+                   r.n, '$libdir/simple_' || r.n, 'int_func');
+    EXECUTE format('CREATE FUNCTION text_func_%s(text) RETURNS text AS %L, %L LANGUAGE C STRICT',
+                   r.n, '$libdir/simple_' || r.n, 'text_func');
+  END LOOP;
+END;
+$$;
+
+-- query should to use %1$s instead of lesson's number
+CREATE FUNCTION pg_temp.lesson_elapsed(n int, query text)
+RETURNS interval AS $$
+DECLARE t timestamptz := clock_timestamp();
+BEGIN
+  EXECUTE format(query, n);
+  RETURN clock_timestamp() - t;
+END;
+$$ LANGUAGE plpgsql;
+
+SELECT n, pg_temp.lesson_elapsed(n, 'SELECT sum(int_func_%1$s(i)) FROM generate_series(1, 1000000) g(i)') < int_func_limit AS int_func,
+       pg_temp.lesson_elapsed(n, 'SELECT count(text_func_%1$s(''row '' || i)) FROM generate_series(1, 20000) g(i)') < text_func_limit AS text_func
+  FROM lessons_perf ORDER BY n;
+
+DO $$
+DECLARE r record;
+BEGIN
+  FOR r IN SELECT * FROM lessons_perf
+  LOOP
+    EXECUTE format('DROP FUNCTION int_func_%s(int)', r.n);
+    EXECUTE format('DROP FUNCTION text_func_%s(text)', r.n);
+  END LOOP;
+END;
+$$;
+
+DROP TABLE lessons_perf;
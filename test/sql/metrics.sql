@@ -0,0 +1,71 @@
+-- the hooks are active after loading of library
+LOAD 'simple';
+
+SET client_min_messages TO warning;
+
+-- without shared_preload_libraries the shared memory is available since PG 17
+SELECT current_setting('server_version_num')::int < 170000 AND
+       current_setting('shared_preload_libraries') !~ 'simple' AS skip_test \gset
+\if :skip_test
+\quit
+\endif
+
+SELECT simple_query_stats_reset();
+
+-- the name of function is stored at the end of statement, so the
+-- escaping of labels can be checked with renamed text_func
+CREATE FUNCTION pg_temp.rename_text_func(name text)
+RETURNS void AS $$
+BEGIN
+  EXECUTE format('ALTER FUNCTION text_func(text) RENAME TO %I', name);
+END;
+$$ LANGUAGE plpgsql;
+
+SET simple.track_queries TO on;
+
+SELECT sum(int_func(i)) FROM generate_series(1, 100) g(i);
+
+BEGIN;
+SELECT count(text_func('x' || i)), pg_temp.rename_text_func(E'text"func\\\n')
+  FROM generate_series(1, 3) g(i);
+-- the original name is restored
+ROLLBACK;
+
+RESET simple.track_queries;
+
+CREATE TEMP TABLE metrics AS
+  SELECT n, m[1] AS metric,
+         substring(m[2] FROM 'function=("(?:[^"\\]|\\.)*")') AS function,
+         substring(m[2] FROM ',le="([^"]+)"$')::float8 AS le,
+         m[3]::float8 AS value
+    FROM regexp_split_to_table(simple_metrics(), E'\n') WITH ORDINALITY l(line, n),
+         regexp_match(line, '^(\w+)\{(.*)\} (\S+)$') m
+   WHERE m[2] LIKE format('datid="%s",%%',
+                          (SELECT oid FROM pg_database
+                            WHERE datname = current_database()));
+
+-- backslash, double quote and new line are escaped
+SELECT DISTINCT function FROM metrics ORDER BY function;
+
+-- the buckets are cumulative and ordered by upper bound (the last is +Inf)
+SELECT function, count(*) AS buckets,
+       bool_and(value >= prev_value) AS cumulative,
+       bool_and(le > prev_le) AS ordered,
+       max(le) = 'Infinity' AS inf
+  FROM (SELECT function, le, value,
+               lag(value, 1, 0) OVER w AS prev_value,
+               lag(le, 1, '-Infinity') OVER w AS prev_le
+          FROM metrics
+         WHERE metric = 'simple_function_duration_seconds_bucket'
+        WINDOW w AS (PARTITION BY function ORDER BY n)) b
+ GROUP BY function
+ ORDER BY function;
+
+-- the count is same like +Inf bucket
+SELECT c.function, c.value AS count, c.value = b.value AS inf_bucket
+  FROM metrics c
+       JOIN metrics b USING (function)
+ WHERE c.metric = 'simple_function_duration_seconds_count'
+   AND b.metric = 'simple_function_duration_seconds_bucket'
+   AND b.le = 'Infinity'
+ ORDER BY function;
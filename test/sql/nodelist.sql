@@ -0,0 +1,16 @@
+LOAD 'simple';
+
+SELECT simple_nodes_encode('("a" 10 true)');
+SELECT simple_nodes_decode(simple_nodes_encode('("a" 10 true)'));
+
+-- the bench function checks if decoded list is equal to original list
+SELECT format, size > 0 AS size FROM simple_nodes_bench(1000);
+
+SELECT (SELECT size FROM simple_nodes_bench(1000) WHERE format = 'binary') <
+       (SELECT size FROM simple_nodes_bench(1000) WHERE format = 'text') AS smaller;
+
+-- errors
+SELECT simple_nodes_encode('(i 1 2)');
+SELECT simple_nodes_decode('\x01');
+SELECT simple_nodes_decode('\x014c00000002');
+SELECT simple_nodes_decode('\x0158');
@@ -0,0 +1,35 @@
+LOAD 'simple';
+
+SELECT 'a=1, b = "x y", "c=d"=""'::optbag;
+SELECT 'a=1, a=2'::optbag;
+SELECT ''::optbag, optbag_count('');
+
+SELECT optbag_get('a=1, b=2', 'b'), optbag_get('a=1, b=2', 'c') IS NULL AS missing;
+SELECT optbag_set('a=1', 'b', 'světe'), optbag_set('a=1', 'a', 'Ahoj'), optbag_set(NULL, 'k', 'v');
+
+-- flat form is stored
+CREATE TABLE optbag_tab(bag optbag);
+INSERT INTO optbag_tab VALUES ('a=1'), (optbag_set('a=1', 'b', '2'));
+SELECT bag, optbag_count(bag), optbag_get(bag, 'b') FROM optbag_tab;
+DROP TABLE optbag_tab;
+
+-- the variable holds expanded optbag
+DO $$
+DECLARE
+  bag optbag;
+BEGIN
+  FOR i IN 1..10000
+  LOOP
+    bag := optbag_set(bag, 'key ' || i % 1000, 'value ' || i);
+  END LOOP;
+
+  RAISE NOTICE 'count: %, key 10: %, key 999: %',
+    optbag_count(bag), optbag_get(bag, 'key 10'), optbag_get(bag, 'key 999');
+END;
+$$;
+
+-- errors
+SELECT 'a'::optbag;
+SELECT 'a=1,'::optbag;
+SELECT 'a="1'::optbag;
+SELECT optbag_set('a=1', 'b', NULL);
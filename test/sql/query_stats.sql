@@ -0,0 +1,44 @@
+-- the hooks are active after loading of library
+LOAD 'simple';
+
+-- without shared_preload_libraries the queryId is not computed by default
+SET compute_query_id TO on;
+SET client_min_messages TO warning;
+
+-- without shared_preload_libraries the shared memory is available since PG 17
+SELECT current_setting('server_version_num')::int < 170000 AND
+       current_setting('shared_preload_libraries') !~ 'simple' AS skip_test \gset
+\if :skip_test
+\quit
+\endif
+
+SELECT simple_query_stats_reset();
+
+SET simple.track_queries TO on;
+
+SELECT sum(int_func(i)) FROM generate_series(1, 100) g(i);
+SELECT sum(int_func(i)) FROM generate_series(1, 100) g(i);
+SELECT count(text_func('x' || i)) FROM generate_series(1, 10) g(i);
+
+-- the calls inside DO are attributed to DO statement
+DO $$
+BEGIN
+  PERFORM int_func(1);
+  PERFORM int_func(2);
+END;
+$$;
+
+RESET simple.track_queries;
+
+-- not tracked
+SELECT int_func(1);
+
+-- the same queries have same queryId
+SELECT funcid, count(DISTINCT queryid) AS queries, sum(calls) AS calls,
+       bool_and(queryid <> 0) AS queryid, bool_and(total_time >= 0) AS total_time
+  FROM simple_query_stats()
+ WHERE dbid = (SELECT oid FROM pg_database WHERE datname = current_database())
+ GROUP BY funcid
+ ORDER BY funcid::regprocedure::text;
+
+RESET compute_query_id;
@@ -2,3 +2,45 @@ CREATE EXTENSION simple;
 
 SELECT int_func(10);
 SELECT text_func('Ahoj');
+
+-- overflow is checked
+SELECT int_func(2147483637);
+SELECT int_func(2147483638);
+
+SELECT int_func(10::smallint), int_func(10::bigint);
+SELECT int_func(32758::smallint);
+SELECT int_func(9223372036854775807);
+
+-- arrays, the read/write expanded variable is modified in place
+SELECT int_func(ARRAY[1, NULL, 3]), int_func('{{1,2},{3,4}}'::int[]), int_func('{}'::int[]);
+SELECT int_func(ARRAY[1, 2147483638]);
+
+DO $$
+DECLARE
+  a int[] := ARRAY[1, NULL, 2147483617];
+BEGIN
+  FOR i IN 1..5
+  LOOP
+    BEGIN
+      a := int_func(a);
+    EXCEPTION WHEN numeric_value_out_of_range THEN
+      RAISE NOTICE 'iteration %: %', i, a;
+    END;
+  END LOOP;
+END;
+$$;
+
+SET client_min_messages TO warning;
+
+SELECT text_func(NULL) IS NULL AS "null", text_func('') AS empty, text_func('Příliš žluťoučký kůň');
+
+-- toasted (compressed and external) values
+CREATE TABLE simple_toast(c text, e text);
+ALTER TABLE simple_toast ALTER COLUMN e SET STORAGE EXTERNAL;
+INSERT INTO simple_toast SELECT v, v FROM repeat('Příliš žluťoučký kůň ', 500000) v;
+
+SELECT length(text_func(c)) - length(c) AS c_added, right(text_func(c), 7) AS c_suffix,
+       length(text_func(e)) - length(e) AS e_added, right(text_func(e), 7) AS e_suffix
+  FROM simple_toast;
+
+DROP TABLE simple_toast;
@@ -0,0 +1,20 @@
+LOAD 'simple';
+
+SET client_min_messages TO warning;
+
+SELECT text_func_batch(ARRAY['Ahoj', NULL, 'Nazdar']);
+SELECT text_func_batch('{}');
+SELECT text_func_batch(NULL);
+
+-- same result like text_func
+SELECT text_func_batch(array_agg('row ' || i ORDER BY i)) =
+       array_agg(text_func('row ' || i) ORDER BY i)
+  FROM generate_series(1, 1000) g(i);
+
+-- saved plan is reused by next call
+SELECT text_func_batch(ARRAY['Hello']);
+
+-- without fast path of simple expressions
+SET simple.pipeline_fast_path TO off;
+SELECT text_func_batch(ARRAY['Ahoj', NULL, 'Nazdar']);
+RESET simple.pipeline_fast_path;
@@ -0,0 +1,43 @@
+LOAD 'simple';
+
+SET client_min_messages TO warning;
+
+-- the statistics are collected only when simple is in shared_preload_libraries,
+-- so the test checks only the consistency of values
+SELECT simple_spi_stats_reset();
+
+SELECT text_func_batch(ARRAY['Ahoj', NULL, 'Nazdar']);
+
+SELECT funcid FROM simple_spi_stats
+ WHERE executions < 0 OR rows < 0 OR total_time < 0;
+
+-- NULL for functions without statistics
+SELECT simple_spi_stats('int_func(int)'::regprocedure) IS NULL AS no_stats;
+
+-- the counters are changed only with custom statistics kind
+SELECT current_setting('server_version_num')::int < 180000 OR
+       current_setting('shared_preload_libraries') !~ 'simple' AS skip_test \gset
+\if :skip_test
+\quit
+\endif
+
+-- fast path evaluates simple queries without SPI
+SET simple.pipeline_fast_path TO off;
+
+-- pending counters are flushed after next statement
+SELECT pg_stat_force_next_flush();
+
+SELECT coalesce(executions, 0) AS executions,
+       coalesce(rows, 0) AS rows
+  FROM simple_spi_stats('text_func_batch(text[])'::regprocedure) \gset
+
+SELECT text_func_batch(ARRAY['Ahoj', NULL, 'Nazdar']);
+
+SELECT pg_stat_force_next_flush();
+
+-- two queries, one row per query
+SELECT executions - :executions AS executions,
+       rows - :rows AS rows
+  FROM simple_spi_stats('text_func_batch(text[])'::regprocedure);
+
+RESET simple.pipeline_fast_path;
@@ -0,0 +1,37 @@
+LOAD 'simple';
+
+SELECT simple_sum(int_func(i)) FROM generate_series(1, 10) g(i);
+SELECT simple_sum(int_func(i::bigint)) FROM generate_series(1, 10) g(i);
+
+-- sum of no rows or only NULLs is NULL
+SELECT simple_sum(i) FROM generate_series(1, 0) g(i);
+SELECT simple_sum(x) FROM (VALUES (1), (NULL), (3)) v(x);
+
+-- moving frame (inverse transition function)
+SELECT i, x, simple_sum(x) OVER (ORDER BY i ROWS BETWEEN 1 PRECEDING AND CURRENT ROW)
+  FROM (VALUES (1, 1), (2, NULL), (3, NULL), (4, 4), (5, 5)) v(i, x);
+
+SELECT bool_and(s1 = s2) AS same, count(*)
+  FROM (SELECT sum(int_func(i)) OVER w AS s1, simple_sum(int_func(i)) OVER w AS s2
+          FROM generate_series(1, 1000) g(i)
+        WINDOW w AS (ORDER BY i ROWS BETWEEN 10 PRECEDING AND CURRENT ROW)) s;
+
+-- overflow is checked
+SELECT simple_sum(x) FROM (VALUES (9223372036854775807), (1)) v(x);
+
+-- parallel aggregation (combine function)
+CREATE TABLE sum_agg_test AS SELECT i FROM generate_series(1, 100000) g(i);
+
+SET parallel_setup_cost TO 0;
+SET parallel_tuple_cost TO 0;
+SET min_parallel_table_scan_size TO 0;
+SET max_parallel_workers_per_gather TO 2;
+
+SELECT simple_sum(i) = sum(i) AS same FROM sum_agg_test;
+
+RESET parallel_setup_cost;
+RESET parallel_tuple_cost;
+RESET min_parallel_table_scan_size;
+RESET max_parallel_workers_per_gather;
+
+DROP TABLE sum_agg_test;
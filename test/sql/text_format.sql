@@ -0,0 +1,25 @@
+LOAD 'simple';
+
+SELECT text_format_fast('Hello %s, %s!', 'Pavel', 10);
+SELECT text_format_fast('%2$s %1$s %s', 'a', 'b', 'c');
+SELECT text_format_fast('100%% [%s]', NULL::int);
+SELECT text_format_fast('no arguments');
+SELECT text_format_fast(NULL, 1);
+SELECT text_format_fast('%s and %s', VARIADIC ARRAY['x', 'y']);
+SELECT text_format_fast('%s', VARIADIC NULL::text[]);
+
+-- the template is parsed only when it is changed
+SELECT text_format_fast(t, i, 'světe')
+  FROM (VALUES ('[%s] %s', 1), ('[%s] %s', 2), ('%s: %s', 3)) v(t, i);
+
+-- same result like format
+SELECT count(*)
+  FROM generate_series(1, 1000) g(i)
+ WHERE text_format_fast('id: %s, label: %s, value: %s', i, 'row ' || i, i / 7.0) <>
+       format('id: %s, label: %s, value: %s', i, 'row ' || i, i / 7.0);
+
+-- errors
+SELECT text_format_fast('%s %s', 1);
+SELECT text_format_fast('%3$s', 1, 2);
+SELECT text_format_fast('%d', 1);
+SELECT text_format_fast('abc %', 1);
@@ -0,0 +1,25 @@
+SELECT text_func_parallel(ARRAY['Ahoj', NULL, 'Nazdar'], 2);
+SELECT text_func_parallel('{{a,b},{c,d}}', 3);
+SELECT text_func_parallel('[0:1]={a,b}', 8);
+SELECT text_func_parallel('{}', 4);
+
+SET client_min_messages TO warning;
+
+-- same result like text_func, the order of fields is not changed
+SELECT text_func_parallel(array_agg('row ' || i ORDER BY i), 4) =
+       array_agg(text_func('row ' || i) ORDER BY i) AS same
+  FROM generate_series(1, 100000) g(i);
+
+-- workers are used from PL/pgSQL too
+DO $$
+DECLARE
+  a text[];
+BEGIN
+  a := text_func_parallel(ARRAY(SELECT repeat('x', i) FROM generate_series(1, 1000) g(i)), 3);
+  IF a[1000] <> repeat('x', 1000) || ', světe' THEN
+    RAISE EXCEPTION 'unexpected result';
+  END IF;
+END;
+$$;
+
+SELECT text_func_parallel('{a}', 0);
@@ -0,0 +1,62 @@
+LOAD 'simple';
+
+SET client_min_messages TO warning;
+
+CREATE TABLE tf_test(id int PRIMARY KEY, name text, name_text text);
+
+CREATE TRIGGER tf_test_ins AFTER INSERT ON tf_test
+  REFERENCING NEW TABLE AS new_rows
+  FOR EACH STATEMENT
+  EXECUTE FUNCTION text_func_maintain('id', 'name', 'name_text');
+
+CREATE TRIGGER tf_test_upd AFTER UPDATE ON tf_test
+  REFERENCING OLD TABLE AS old_rows NEW TABLE AS new_rows
+  FOR EACH STATEMENT
+  EXECUTE FUNCTION text_func_maintain('id', 'name', 'name_text');
+
+INSERT INTO tf_test VALUES (1, 'Ahoj'), (2, 'Nazdar'), (3, NULL);
+SELECT * FROM tf_test ORDER BY id;
+
+-- the source is not changed, so the target is not recomputed
+UPDATE tf_test SET name_text = 'manual' WHERE id = 2;
+SELECT * FROM tf_test ORDER BY id;
+
+UPDATE tf_test SET name = name || '!';
+SELECT * FROM tf_test ORDER BY id;
+
+-- changed key
+UPDATE tf_test SET id = 10, name = 'Čau' WHERE id = 1;
+SELECT * FROM tf_test ORDER BY id;
+
+-- keys swapped by one statement, all updated rows are recomputed
+CREATE TABLE tf_swap(id int UNIQUE DEFERRABLE, name text, name_text text);
+
+CREATE TRIGGER tf_swap_upd AFTER UPDATE ON tf_swap
+  REFERENCING OLD TABLE AS old_rows NEW TABLE AS new_rows
+  FOR EACH STATEMENT
+  EXECUTE FUNCTION text_func_maintain('id', 'name', 'name_text');
+
+INSERT INTO tf_swap VALUES (1, 'Ahoj', 'Ahoj, světe'), (2, 'Nazdar', 'Nazdar, světe');
+UPDATE tf_swap SET id = 3 - id, name = CASE id WHEN 1 THEN 'Nazdar' ELSE 'Ahoj' END;
+SELECT * FROM tf_swap ORDER BY id;
+DROP TABLE tf_swap;
+
+-- the plan is reused
+UPDATE tf_test SET name = 'Servus' WHERE id = 3;
+SELECT * FROM tf_test ORDER BY id;
+
+-- wrong usage
+CREATE TRIGGER tf_test_row AFTER DELETE ON tf_test
+  FOR EACH ROW
+  EXECUTE FUNCTION text_func_maintain('id', 'name', 'name_text');
+DELETE FROM tf_test WHERE id = 2;
+DROP TRIGGER tf_test_row ON tf_test;
+
+CREATE TRIGGER tf_test_bad AFTER UPDATE ON tf_test
+  REFERENCING OLD TABLE AS old_rows NEW TABLE AS new_rows
+  FOR EACH STATEMENT
+  EXECUTE FUNCTION text_func_maintain('id', 'nosuchcolumn', 'name_text');
+UPDATE tf_test SET name = 'x' WHERE id = 2;
+DROP TRIGGER tf_test_bad ON tf_test;
+
+DROP TABLE tf_test;
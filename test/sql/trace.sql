@@ -0,0 +1,30 @@
+-- the hooks are active after loading of library
+LOAD 'simple';
+
+SET client_min_messages TO warning;
+
+-- without shared_preload_libraries the shared memory is available since PG 17
+SELECT current_setting('server_version_num')::int < 170000 AND
+       current_setting('shared_preload_libraries') !~ 'simple' AS skip_test \gset
+\if :skip_test
+\quit
+\endif
+
+-- only events of this test
+SELECT coalesce(max(pos) + 1, 0) AS since FROM simple_trace_read() \gset
+
+SET simple.trace_calls TO on;
+
+SELECT sum(int_func(i)) FROM generate_series(1, 2) g(i);
+SELECT text_func('hello');
+SELECT int_func(2147483647);
+
+RESET simple.trace_calls;
+
+-- not traced
+SELECT int_func(1);
+
+SELECT funcid, event, ts <= now() + interval '1 hour' AS ts
+  FROM simple_trace_read(:since)
+ WHERE pid = pg_backend_pid()
+ ORDER BY pos;